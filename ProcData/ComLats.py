@@ -3,13 +3,10 @@ import numpy as np
 def load_data(path):
     Datas = []
     with open(path) as fr:
-        count = 0
         for f in fr:
-            count += 1
-            if count > 5:
-                data = f[:-1]
-                if data != "":
-                    Datas.append(int(data))
+            data = f[:-1]
+            if data != "":
+                Datas.append(int(data))
 
     return Datas
 
@@ -45,7 +42,7 @@ def getRes(Name,L=10000,S=512):
 
     Ls = {}
     for a in Algos:
-        Path = Root + Name + "/" + a + "Cache_" + str(S) + "c_" + str(L) + "l.txt"
+        Path = Root + Name + "/" + a + "Cache_" + str(S) + "c_" + str(L) + "l_lats.txt"
         Lats = load_data(Path)
         Ls[a] = Lats
 
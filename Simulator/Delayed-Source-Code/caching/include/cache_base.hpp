@@ -3,61 +3,81 @@
 
 // STD headers
 #include <assert.h>
+#include <atomic>
+#include <cmath>
+#include <exception>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 // Boost headers
-#include <boost/bimap.hpp>
 #include <boost/program_options.hpp>
 
 // Custom headers
 #include "utils.hpp"
+#include "flat_hash_map.hpp"
+#include "trace_reader.hpp"
+#include "decoded_trace.hpp"
+#include "pipelined_trace_reader.hpp"
+#include "latency_histogram.hpp"
 #include "cache_common.hpp"
 
-template<class T>
-std::vector<std::string> split(const std::string& s, const T& separator, bool ignore_empty = 0, bool split_empty = 0)
-{
-  struct {
-    auto len(const std::string&             s) { return s.length(); }
-    auto len(const std::string::value_type* p) { return p ? std::char_traits<std::string::value_type>::length(p) : 0; }
-    auto len(const std::string::value_type  c) { return c == std::string::value_type() ? 0 : 1; /*return 1;*/ }
-  } util;
-  
-  if (s.empty()) { /// empty string ///
-    if (!split_empty || util.len(separator)) return {""};
-    return {};
-  }
-  
-  auto v = std::vector<std::string>();
-  auto n = static_cast<std::string::size_type>(util.len(separator));
-  if (n == 0) {    /// empty separator ///
-    if (!split_empty) return {s};
-    for (auto&& c : s) v.emplace_back(1, c);
-    return v;
-  }
-  
-  auto p = std::string::size_type(0);
-  while (1) {      /// split with separator ///
-    auto pos = s.find(separator, p);
-    if (pos == std::string::npos) {
-      if (ignore_empty && p - n + 1 == s.size()) break;
-      v.emplace_back(s.begin() + p, s.end());
-      break;
-    }
-    if (!ignore_empty || p != pos)
-      v.emplace_back(s.begin() + p, s.begin() + pos);
-    p = pos + n;
-  }
-  return v;
-}
+namespace caching {
 
+/**
+ * Represents a blocking read which is in flight.
+ *
+ * By default, this is a compact record: the packet which triggered the
+ * read, plus the number and accumulated latency of the delayed hits
+ * queued behind it. The delayed-hit packets themselves are retained
+ * only when requested (i.e., for the raw packets output, or when the
+ * policy replays them; see BaseCacheSet::needsQueuedPackets()).
+ */
+class InFlightRead {
+private:
+    utils::Packet packet_; // The packet which triggered this read
+    double completion_time_; // Time (in clock cycles) when the read completes
+    bool is_retaining_packets_; // Whether delayed-hit packets are retained
+    size_t num_delayed_hits_ = 0; // Number of delayed hits on this read
+    double total_latency_ = 0; // Accumulated latency of all queued packets
+    std::vector<utils::Packet> delayed_packets_; // Delayed hits (if retained)
 
-namespace caching {
+public:
+    InFlightRead(const utils::Packet& packet, const double completion_time,
+                 const bool retain_packets) : packet_(packet),
+                 completion_time_(completion_time),
+                 is_retaining_packets_(retain_packets),
+                 total_latency_(packet.getTotalLatency()) {}
+
+    // Accessors
+    FlowId getFlowId() const { return packet_.getFlowId(); }
+    const utils::Packet& getPacket() const { return packet_; }
+    double getCompletionTime() const { return completion_time_; }
+    bool isRetainingPackets() const { return is_retaining_packets_; }
+    size_t getNumDelayedHits() const { return num_delayed_hits_; }
+    size_t getNumPackets() const { return num_delayed_hits_ + 1; }
+    double getTotalLatency() const { return total_latency_; }
+    const std::vector<utils::Packet>&
+    getDelayedPackets() const { return delayed_packets_; }
+
+    /**
+     * Records a delayed hit on this read.
+     */
+    void addDelayedHit(const utils::Packet& packet) {
+        num_delayed_hits_++;
+        total_latency_ += packet.getTotalLatency();
+        if (is_retaining_packets_) { delayed_packets_.push_back(packet); }
+    }
+};
 
 /**
  * Abstract base class representing a generic cache-set.
@@ -66,24 +86,22 @@ class BaseCacheSet {
 protected:
     const size_t kNumEntries; // The number of cache entries in this set
     const size_t MissLatency;
-    std::unordered_set<std::string> occupied_entries_set_; // Set of currently
-                                                           // cached flow IDs.
-    std::vector<std::string> TraceIds;
+    utils::FlatHashSet<FlowId> occupied_entries_set_; // Set of currently
+                                                      // cached flow IDs.
 
 public:
     BaseCacheSet(const size_t num_entries, const size_t misslat) : kNumEntries(num_entries),MissLatency(misslat) {}
     virtual ~BaseCacheSet() {}
 
     
-    virtual void inittrace(std::vector<std::string> Ids) {SUPPRESS_UNUSED_WARNING(Ids);}
+    virtual void inittrace(const std::vector<FlowId>& Ids) {SUPPRESS_UNUSED_WARNING(Ids);}
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size)=0;
+    update_freqs(const FlowId key, uint64_t size)=0;
 
     // Membership test (internal use only)
-    bool contains(const std::string& flow_id) const {
-        return (occupied_entries_set_.find(flow_id) !=
-                occupied_entries_set_.end());
+    bool contains(const FlowId flow_id) const {
+        return occupied_entries_set_.contains(flow_id);
     }
     /**
      * Returns the number of cache entries in this set
@@ -105,7 +123,14 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) = 0;
+    write(const FlowId key, const utils::Packet& packet) = 0;
+
+    /**
+     * Whether this policy needs every delayed-hit packet when a read
+     * completes (see writeq()). Policies that override this to return
+     * true receive the retained packets in InFlightRead.
+     */
+    virtual bool needsQueuedPackets() const { return false; }
 
     /**
      * Simulates a sequence of cache writes for a particular flow's packet queue.
@@ -113,13 +138,13 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) {
-        CacheEntry written_entry;
-        for (const auto& packet : queue) {
+    writeq(const InFlightRead& read) {
+        CacheEntry written_entry = write(read.getFlowId(), read.getPacket());
+        for (const auto& packet : read.getDelayedPackets()) {
             written_entry = write(packet.getFlowId(), packet);
         }
         return written_entry;
@@ -141,22 +166,58 @@ protected:
     size_t clk_ = 0; // Time in clock cycles
     size_t total_latency_ = 0; // Total packet latency
     std::vector<BaseCacheSet*> cache_sets_; // Fixed-sized array of CacheSet instances
-    std::unordered_set<std::string> memory_entries_; // Set of keys in the global store
-    boost::bimap<size_t, std::string> completed_reads_; // A dictionary mapping clk values to the keys
-                                                        // whose blocking reads complete on that cycle.
+    utils::FlowIdTable flow_ids_; // Interns flow IDs into dense handles
+    const utils::FlowIdTable* shared_flow_ids_ = nullptr; // A shared trace's table (if replaying one)
+    std::vector<bool> memory_entries_; // Whether each flow is in the global store
+    size_t num_memory_entries_ = 0; // Number of flows in the global store
+    bool is_retaining_packets_ = false; // Whether processed packets are kept
 
-    std::unordered_map<std::string, std::list<utils::Packet>>
-    packet_queues_; // Dictionary mapping keys to queued requests. Each queue
-                    // contains zero or more packets waiting to be processed.
+    utils::FlatHashMap<FlowId, InFlightRead>
+    in_flight_reads_; // Dictionary mapping keys to blocking reads in flight.
 
-    std::vector<std::string> TraceIds;
+    std::vector<FlowId> TraceIds;
     size_t Misses = 0;
     size_t FHits = 0;
     size_t DHits = 0;
-    std::string HITRecd = "";
-    std::string LATRecd = "";
     double BWidth = 104857600;
-    std::unordered_map<std::string, double> Arrives;
+
+    // A pending blocking read: (completion time, issue clk, key)
+    typedef std::tuple<double, size_t, FlowId> Completion;
+    std::priority_queue<Completion, std::vector<Completion>,
+                        std::greater<Completion>>
+    completions_; // Min-heap of outstanding reads, ordered by completion time
+
+    // Per-request latency statistics, by hit type
+    utils::LatencyHistogram full_hit_latencies_;
+    utils::LatencyHistogram delayed_hit_latencies_;
+    utils::LatencyHistogram miss_latencies_;
+
+    // Raw per-request latencies (optional), streamed to disk in chunks
+    static constexpr size_t kLatenciesChunkSize = (1 << 20);
+    std::ofstream latencies_file_;
+    std::string latencies_buffer_;
+
+    /**
+     * Internal helper method. Records the latency of a single request.
+     */
+    void recordLatency(utils::LatencyHistogram& histogram, const double latency) {
+        histogram.record(latency);
+        if (latencies_file_.is_open()) {
+            latencies_buffer_ += std::to_string(int(latency));
+            latencies_buffer_ += '\n';
+            if (latencies_buffer_.size() >= kLatenciesChunkSize) {
+                flushLatencies();
+            }
+        }
+    }
+
+    /**
+     * Internal helper method. Writes out any buffered raw latencies.
+     */
+    void flushLatencies() {
+        latencies_file_ << latencies_buffer_;
+        latencies_buffer_.clear();
+    }
 
 public:
     BaseCache(const size_t miss_latency, const size_t cache_set_associativity, const size_t
@@ -185,6 +246,22 @@ public:
         SUPPRESS_UNUSED_WARNING(packet);
     }
 
+    /**
+     * Whether this policy needs the full sequence of flow IDs up front
+     * (see setTraceIds()). Online policies stream the trace in a single
+     * pass; only offline policies should override this.
+     */
+    virtual bool requiresFutureKnowledge() const { return false; }
+
+    /**
+     * Whether this policy's cache sets are independent, i.e., they
+     * share no state other than the clock (and the per-flow in-flight
+     * reads), so that disjoint groups of sets may be simulated in
+     * parallel (see benchmarkSets()). Policies that keep cache-level
+     * state (e.g., a shared model) must not override this.
+     */
+    virtual bool hasIndependentSets() const { return false; }
+
 
     bool Init = 0;
 
@@ -196,7 +273,14 @@ public:
     /**
      * Returns the number of entries in the memory at any instant.
      */
-    size_t getNumMemoryEntries() const { return memory_entries_.size(); }
+    size_t getNumMemoryEntries() const { return num_memory_entries_; }
+
+    /**
+     * Returns the table mapping flow IDs to dense handles.
+     */
+    const utils::FlowIdTable& getFlowIds() const {
+        return (shared_flow_ids_ != nullptr) ? *shared_flow_ids_ : flow_ids_;
+    }
 
     size_t getCacheNumEntries() const { return kMaxNumCacheEntries; }
 
@@ -213,23 +297,25 @@ public:
     /**
      * 返回 Hit Probability
     */
-    std::vector<size_t> getHits(){
+    std::vector<size_t> getHits() const {
          std::vector<size_t> Res = {FHits, DHits, Misses};
          return Res;
     }
 
-    std::vector<std::string> getDynRecd(){
-        std::vector<std::string> Res = {HITRecd,LATRecd};
-        return Res;
-    }
+    /**
+     * Returns the latency histograms for full hits, delayed hits, and misses.
+     */
+    const utils::LatencyHistogram& getFullHitLatencies() const { return full_hit_latencies_; }
+    const utils::LatencyHistogram& getDelayedHitLatencies() const { return delayed_hit_latencies_; }
+    const utils::LatencyHistogram& getMissLatencies() const { return miss_latencies_; }
 
 
     /**
      * Returns the cache index corresponding to the given key.
      */
-    size_t getCacheIndex(const std::string& key) const {
+    size_t getCacheIndex(const FlowId key) const {
         return (kMaxNumCacheSets == 1) ?
-            0 : kHashFamily.hash(0, key) % kMaxNumCacheSets;
+            0 : kHashFamily.hash(0, getFlowIds().name(key)) % kMaxNumCacheSets;
     }
 
     /**
@@ -237,19 +323,42 @@ public:
      */
     void incrementClk() { clk_++; }
 
-    void setTraceIds(std::vector<std::string> Ids){TraceIds = Ids;}
+    void setTraceIds(std::vector<FlowId>&& Ids){TraceIds = std::move(Ids);}
 
     /**
-     * Handles any blocking read completions on this cycle.
+     * Sets whether every processed packet is passed back to the caller
+     * (e.g., for the raw packets output). Otherwise, only aggregate
+     * statistics are kept for delayed hits.
      */
-    void processAll(std::list<utils::Packet>& processed_packets) {
+    void setRetainPackets(const bool retain) { is_retaining_packets_ = retain; }
 
-        // A blocking read completed on this cycle
-        auto completed_read = completed_reads_.left.find(clk());
-        if (completed_read != completed_reads_.left.end()) {
-            const std::string& key = completed_read->second;
-            std::list<utils::Packet>& queue = packet_queues_.at(key);
-            assert(!queue.empty()); // Sanity check: Queue may not be empty
+    /**
+     * Streams the latency of every request (one per line, in trace
+     * order) to the given file. By default, only histograms are kept.
+     */
+    void setLatenciesOutput(const std::string& latencies_fp) {
+        latencies_file_.open(latencies_fp, std::ios::out | std::ios::trunc);
+        if (!latencies_file_) { throw std::runtime_error(
+            "Could not open latencies file: " + latencies_fp);
+        }
+    }
+
+    /**
+     * Commits every blocking read that completes on or before this
+     * cycle, then increments the clock. Only the reads which actually
+     * complete are touched; the rest remain in the completion heap.
+     */
+    void processAriv(std::list<utils::Packet>& processed_packets) {
+        double TimeNow = clk();
+
+        while (!completions_.empty() &&
+               std::get<0>(completions_.top()) <= TimeNow) {
+            const FlowId key = std::get<2>(completions_.top());
+            completions_.pop();
+
+            auto read_iter = in_flight_reads_.find(key);
+            assert(read_iter != in_flight_reads_.end());
+            const InFlightRead& read = read_iter->second;
 
             // Fetch the cache set corresponding to this key
             size_t cache_idx = getCacheIndex(key);
@@ -257,67 +366,21 @@ public:
 
             // Sanity checks
             assert(!cache_set.contains(key));
-            assert(queue.front().getTotalLatency() == kCacheMissLatency);
 
             // Commit the queued entries
-            cache_set.writeq(queue);
-            processed_packets.insert(processed_packets.end(),
-                                     queue.begin(), queue.end());
-
-            // Purge the queue, as well as the bidict mapping
-            queue.clear();
-            packet_queues_.erase(key);
-            completed_reads_.left.erase(completed_read);
-        }
-
-        // Finally, increment the clock
-        incrementClk();
-    }
-
-
-
-    void processAriv(std::list<utils::Packet>& processed_packets) {
-        std::unordered_map<std::string, double>::iterator Iter;
-        double TimeNow = clk();
-        std::vector<std::string> DelKeys;
-
-        for(Iter = Arrives.begin();Iter != Arrives.end();Iter++){
-            double ariv_time = Iter->second;
-            std::string key = Iter->first;
-            if(ariv_time <= TimeNow){
-                std::list<utils::Packet>& queue = packet_queues_.at(key);
-            assert(!queue.empty()); // Sanity check: Queue may not be empty
-
-                // Fetch the cache set corresponding to this key
-                size_t cache_idx = getCacheIndex(key);
-                BaseCacheSet& cache_set = *cache_sets_[cache_idx];
-
-                //std::cout<<gsize<<std::endl;
-		
-                // Sanity checks
-                assert(!cache_set.contains(key));
-
-                // Commit the queued entries
-                cache_set.writeq(queue);
+            cache_set.writeq(read);
+            if (is_retaining_packets_) {
+                processed_packets.push_back(read.getPacket());
                 processed_packets.insert(processed_packets.end(),
-                                     queue.begin(), queue.end());
-
-                // Purge the queue, as well as the bidict mapping
-                queue.clear();
-                packet_queues_.erase(key);
-                DelKeys.push_back(key);
+                                         read.getDelayedPackets().begin(),
+                                         read.getDelayedPackets().end());
             }
-         }
-         
-         std::vector<std::string>::iterator Vcer;
-         for(Vcer=DelKeys.begin();Vcer!=DelKeys.end();Vcer++){
-                Arrives.erase(*Vcer);
-         }
-         incrementClk();
+            // Purge the in-flight record
+            in_flight_reads_.erase(read_iter);
+        }
+        incrementClk();
     }
 
-
-
     /**
      * Processes the parameterized packet.
      */
@@ -325,14 +388,17 @@ public:
                  utils::Packet>& processed_packets) {
         packet.setArrivalClock(clk());
 
-        const std::string& key = packet.getFlowId();
-        auto queue_iter = packet_queues_.find(key);
+        const FlowId key = packet.getFlowId();
+        auto read_iter = in_flight_reads_.find(key);
         BaseCacheSet& cache_set = *cache_sets_.at(
             getCacheIndex(key));
  
         if(Init == 0){
             cache_set.inittrace(TraceIds);
             Init = 1;
+
+            // The cache set keeps whatever it needs; release our copy
+            std::vector<FlowId>().swap(TraceIds);
         }
         uint64_t size = packet.getFlowSize();
         cache_set.update_freqs(key,size);
@@ -343,9 +409,13 @@ public:
         cache_set.recordPacketArrival(packet);
 
         // If this packet corresponds to a new flow, allocate its context
-        if (memory_entries_.find(key) == memory_entries_.end()) {
+        if (key >= memory_entries_.size() || !memory_entries_[key]) {
             assert(!cache_set.contains(key));
-            memory_entries_.insert(key);
+            if (key >= memory_entries_.size()) {
+                memory_entries_.resize(getFlowIds().size(), false);
+            }
+            memory_entries_[key] = true;
+            num_memory_entries_++;
 
             if (!kIsPenalizeInsertions) {
                 cache_set.write(key, packet);
@@ -353,61 +423,90 @@ public:
         }
         // First, if the flow is cached, process the packet immediately.
         // This implies that the packet queue must be non-existent.
-        std::string hittype = "2";
-        std::string lattype = "0\n";
         if (cache_set.contains(key)) {
             FHits += 1;
 
-            assert(queue_iter == packet_queues_.end());
+            assert(read_iter == in_flight_reads_.end());
 
             cache_set.write(key, packet);
 
             packet.finalize();
-            processed_packets.push_back(packet);
+            if (is_retaining_packets_) { processed_packets.push_back(packet); }
             total_latency_ += packet.getTotalLatency();
+            recordLatency(full_hit_latencies_, packet.getTotalLatency());
         }
         // Else, we must either: a) perform a blocking read from memory,
-        // or b) wait for an existing blocking read to complete. Insert
-        // this packet into the corresponding packet queue.
+        // or b) wait for an existing blocking read to complete. Record
+        // this packet against the corresponding in-flight read.
         else {
-            if (queue_iter == packet_queues_.end()) {
+            if (read_iter == in_flight_reads_.end()) {
                 Misses += 1;
-                hittype = "0";
 
                 double misslatnow = kCacheMissLatency + size * 1000 / (BWidth / 1.0);
                 double target_clk = clk() + misslatnow + 1;
 
-                Arrives[key] = target_clk;
+                completions_.emplace(target_clk, clk(), key);
                 packet.addLatency(misslatnow);
                 packet.finalize();
 
-                // Initialize a new queue for this flow
-                packet_queues_[key].push_back(packet);
+                // Initialize a new in-flight read for this flow
+                in_flight_reads_.emplace(key, InFlightRead(packet, target_clk,
+                    is_retaining_packets_ || cache_set.needsQueuedPackets()));
 
-                lattype = std::to_string(int(misslatnow)) + "\n";
+                recordLatency(miss_latencies_, misslatnow);
             }
             // Update the flow's packet queue
             else {
                 DHits += 1;
-                hittype = "1"; 
 
-                double target_clk = Arrives[key];//completed_reads_.right.at(key);
-                packet.setQueueingDelay(queue_iter->second.size());
+                InFlightRead& read = read_iter->second;
+                double target_clk = read.getCompletionTime();
+                packet.setQueueingDelay(read.getNumPackets());
                 packet.addLatency(target_clk - clk());
                 packet.finalize();
 
-                // Add this packet to the existing flow queue
-                queue_iter->second.push_back(packet);
+                // Add this packet to the existing in-flight read
+                read.addDelayedHit(packet);
 
-                lattype = std::to_string(int(target_clk-clk())) + "\n";
+                recordLatency(delayed_hit_latencies_, target_clk - clk());
             }
             assert(packet.isFinalized()); // Sanity check
             total_latency_ += packet.getTotalLatency();
         }
         // Process any completed reads
         processAriv(processed_packets);
-        HITRecd += hittype;
-        LATRecd += lattype;
+    }
+
+    /**
+     * Advances the clock to the given cycle, as if every cycle until
+     * then were idle. Only the cycles on which a read completes are
+     * actually processed; the rest are skipped.
+     */
+    void skipTo(const size_t target_clk, std::list<utils::Packet>& processed_packets) {
+        while (clk_ < target_clk && !completions_.empty()) {
+            // The next read completes on the first cycle at or after its completion time
+            const size_t next_clk = std::max(clk_, static_cast<size_t>(
+                std::ceil(std::get<0>(completions_.top()))));
+
+            if (next_clk >= target_clk) { break; }
+            clk_ = next_clk;
+            processAriv(processed_packets);
+        }
+        clk_ = std::max(clk_, target_clk);
+    }
+
+    /**
+     * Adds the hit counts, total latency and latency histograms
+     * of another (disjoint) simulation to this one's.
+     */
+    void mergeResults(const BaseCache& other) {
+        FHits += other.FHits;
+        DHits += other.DHits;
+        Misses += other.Misses;
+        total_latency_ += other.total_latency_;
+        full_hit_latencies_.merge(other.full_hit_latencies_);
+        delayed_hit_latencies_.merge(other.delayed_hit_latencies_);
+        miss_latencies_.merge(other.miss_latencies_);
     }
 
     /**
@@ -415,30 +514,41 @@ public:
      */
     void warmupComplete() {
         total_latency_ = 0;
-        packet_queues_.clear();
-        completed_reads_.clear();
+        in_flight_reads_.clear();
+        completions_ = decltype(completions_)();
     }
 
     /**
      * Indicates completion of the simulation.
      */
     void teardown(std::list<utils::Packet>& processed_packets) {
-        while (!packet_queues_.empty()) {
+        while (!completions_.empty()) {
+            // Skip the idle cycles before the next read completes
+            double next_completion = std::get<0>(completions_.top());
+            if (next_completion > clk()) {
+                clk_ = static_cast<size_t>(std::ceil(next_completion));
+            }
             processAriv(processed_packets);
         }
+        assert(in_flight_reads_.empty()); // Sanity check
+        if (latencies_file_.is_open()) {
+            flushLatencies();
+            latencies_file_.close();
+        }
     }
 
     /**
      * Save the raw packet data to file.
      */
     static void savePackets(std::list<utils::Packet>& packets,
-                            const std::string& packets_fp) {
+                            const std::string& packets_fp,
+                            const utils::FlowIdTable& flow_ids) {
         if (!packets_fp.empty()) {
             std::ofstream file(packets_fp, std::ios::out |
                                            std::ios::app);
             // Save the raw packets to file
             for (const utils::Packet& packet : packets) {
-                file << packet.getFlowId() << ";"
+                file << flow_ids.name(packet.getFlowId()) << ";"
                      << static_cast<size_t>(packet.getTotalLatency()) << ";"
                      << static_cast<size_t>(packet.getQueueingDelay()) << std::endl;
             }
@@ -447,10 +557,80 @@ public:
     }
 
     /**
-     * Generate and output model benchmarks.
+     * Returns the lock that serializes console output across
+     * concurrent runs (see defaultBenchmark()).
      */
-    static void benchmark(BaseCache& model, const std::string& trace_fp, const std::
-                          string& packets_fp, const size_t num_warmup_cycles, std::string root_fp) {
+    static std::mutex& getOutputMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    /**
+     * Returns the path (less extension) of the given model's results.
+     */
+    static std::string getResultsPath(const BaseCache& model, const std::string& root_fp) {
+        std::string Root = root_fp;
+        std::string PathW = Root + model.name() + "_" + std::to_string(int(model.getCacheNumEntries()/1024/1024)) + "c_" + std::to_string(model.getCacheMissLatency()) + "l";
+        return PathW;
+    }
+
+    /**
+     * Prints the given model's results, and saves them to file.
+     */
+    static void report(const BaseCache& model, const std::string& PathW) {
+        // Debug: Print trace and simulation statistics. The summary is
+        // assembled first, so that concurrent runs do not interleave.
+        std::ostringstream summary;
+        summary << std::endl;
+        summary << "Results:" << std::endl;
+        summary << "Algorithm: " << model.name() << std::endl;
+        summary << "Total latency: " << model.getTotalLatency() << std::endl;
+        const std::vector<size_t> HITs = model.getHits();
+        summary << "Full Hit: " << HITs[0] << std::endl;
+        summary << "Delayed Hit: " << HITs[1] << std::endl;
+        summary << "Miss: " << HITs[2] << std::endl;
+        summary << "Latency (count;mean;p50;p90;p99;p99.9;max):" << std::endl;
+        summary << "Full Hit: " << model.getFullHitLatencies().getSummary() << std::endl;
+        summary << "Delayed Hit: " << model.getDelayedHitLatencies().getSummary() << std::endl;
+        summary << "Miss: " << model.getMissLatencies().getSummary() << std::endl;
+        summary << "--------------------" << std::endl;
+        summary << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(getOutputMutex());
+            std::cout << summary.str() << std::flush;
+        }
+
+        // Records all Results into a File
+
+        utils::LatencyHistogram all_latencies;
+        all_latencies.merge(model.getFullHitLatencies());
+        all_latencies.merge(model.getDelayedHitLatencies());
+        all_latencies.merge(model.getMissLatencies());
+
+        std::ofstream WFile;
+        WFile.open(PathW + ".txt");
+        WFile << "Total latency is:" << model.getTotalLatency() << std::endl;
+        WFile << "Full Hit:" << HITs[0] << std::endl;
+        WFile << "Delayed Hit:" << HITs[1] << std::endl;
+        WFile << "Miss:" << HITs[2] << std::endl;
+        WFile << "Latency (count;mean;p50;p90;p99;p99.9;max):" << std::endl;
+        WFile << "Full Hit:" << model.getFullHitLatencies().getSummary() << std::endl;
+        WFile << "Delayed Hit:" << model.getDelayedHitLatencies().getSummary() << std::endl;
+        WFile << "Miss:" << model.getMissLatencies().getSummary() << std::endl;
+        WFile << "All:" << all_latencies.getSummary() << std::endl;
+        WFile.close();
+    }
+
+    /**
+     * Simulates the trace yielded by the given source, and outputs the
+     * model benchmarks. On every call, the source sets the flow ID and
+     * size of the next cycle's packet (kInvalidFlowId for idle cycles),
+     * and returns false at the end of trace.
+     */
+    template<class Source>
+    static void simulate(BaseCache& model, Source&& next, const std::string& packets_fp,
+                         const size_t num_warmup_cycles, const std::string& root_fp,
+                         const bool save_latencies) {
         std::list<utils::Packet> packets; // List of processed packets
         size_t num_counted_packets = 0; // Post-warmup packet count
         size_t num_total_packets = 0; // Total packet count
@@ -465,39 +645,16 @@ public:
                  << std::endl;
         }
 
-        //get all trace information
-        if(1>0){
-            // Process the trace
-            std::string line;
-            std::ifstream trace_ifs(trace_fp);
-            std::vector<std::string> TraceIds;
-            while (std::getline(trace_ifs, line)) {
-                std::string timestamp, flow_id;
-
-                // Nonempty packet
-                if (!line.empty()) {
-                    std::stringstream linestream(line);
-                    std::string field;
-                    std::istringstream sin(line);
-                    std::getline(sin,field);
-                
-                    std::string Data = (std::string)field;
-                    std::vector<std::string> GetData = split(Data,";");
-                    timestamp = GetData[0];
-                    flow_id = GetData[1];
-                    TraceIds.push_back(flow_id);
-                 }
-            }
-            model.setTraceIds(TraceIds);
-        }
+        // Only keep every processed packet if they are written out
+        model.setRetainPackets(!packets_fp.empty());
 
+        std::string PathW = getResultsPath(model, root_fp);
+        if (save_latencies) { model.setLatenciesOutput(PathW + "_lats.txt"); }
 
         // Process the trace
-        std::string line;
-        std::ifstream trace_ifs(trace_fp);
-        while (std::getline(trace_ifs, line)) {
-            std::string timestamp, flow_id;
-            uint64_t flow_size = 1;
+        FlowId flow_id;
+        uint64_t flow_size;
+        while (next(flow_id, flow_size)) {
 
             /****************************************
              * Important note: Currently, we ignore *
@@ -505,20 +662,6 @@ public:
              * 1 packet into the system each cycle. *
              ****************************************/
 
-            // Nonempty packet
-            if (!line.empty()) {
-                std::stringstream linestream(line);
-
-                std::string field;
-                std::istringstream sin(line);
-                std::getline(sin,field);
-                
-                std::string Data = (std::string)field;
-                std::vector<std::string> GetData = split(Data,";");
-                timestamp = GetData[0];
-                flow_id = GetData[1];
-                flow_size = std::stoi(GetData[2]);
-            }
             // Cache warmup completed
             if (num_total_cycles == num_warmup_cycles) {
                 model.warmupComplete(); packets.clear();
@@ -528,15 +671,16 @@ public:
             if (num_counted_packets > 0 &&
                 (num_counted_packets + 1) % 100000 == 0) {
                 if (num_total_cycles >= num_warmup_cycles) {
-                    savePackets(packets, packets_fp);
+                    savePackets(packets, packets_fp, model.getFlowIds());
                 }
+                std::lock_guard<std::mutex> lock(getOutputMutex());
                 std::cout << "Processing: " << num_counted_packets + 1 << std::endl;
             }
             // Process the packet
-            if (!flow_id.empty()) {
+            if (flow_id != utils::kInvalidFlowId) {
                 num_total_packets++;
                 num_counted_packets++;
-                utils::Packet packet(flow_id,flow_size);
+                utils::Packet packet(flow_id, flow_size);
                 model.process(packet, packets);
             }
             else { model.processAriv(packets); }
@@ -545,50 +689,205 @@ public:
 
         // Perform teardown
         model.teardown(packets);
-        savePackets(packets, packets_fp);
-
-        // Debug: Print trace and simulation statistics
-        std::cout << std::endl;
-        std::cout<< "Results:" << std::endl;
-        std::cout<< "Algorithm: " << model.name() << std::endl;
-        std::cout << "Total latency: " << model.getTotalLatency() << std::endl;
-        std::vector<size_t> HITs = model.getHits();
-        std::cout << "Full Hit: " << HITs[0] << std::endl;
-	std::cout << "Delayed Hit: " << HITs[1] << std::endl;
-        std::cout << "Miss: " << HITs[2] << std::endl;
-        std::cout<<"--------------------"<<std::endl;
-        std::cout << std::endl;
+        savePackets(packets, packets_fp, model.getFlowIds());
 
-        // Records all Results into a File
+        report(model, PathW);
+    }
 
-        std::string Root = root_fp;
-        std::string PathW = Root + model.name() + "_" + std::to_string(int(model.getCacheNumEntries()/1024/1024)) + "c_" + std::to_string(model.getCacheMissLatency()) + "l.txt";
-        std::ofstream WFile;
-        std::vector<std::string> DynRes = model.getDynRecd();
-        WFile.open(PathW);
-        WFile << "Total latency is:" << model.getTotalLatency() << std::endl;
-        WFile << "Full Hit:" << HITs[0] << std::endl;
-        WFile << "Delayed Hit:" << HITs[1] << std::endl;
-        WFile << "Miss:" << HITs[2] << std::endl;
-        WFile << "Latency:\n" << DynRes[1] << std::endl;
-        WFile.close();
+    /**
+     * Generate and output model benchmarks, streaming the trace from file.
+     * If pipelined, the trace is decoded on a separate producer thread.
+     */
+    static void benchmark(BaseCache& model, const std::string& trace_fp, const std::
+                          string& packets_fp, const size_t num_warmup_cycles, std::string root_fp,
+                          const bool save_latencies=false, const bool pipelined=false) {
+        // Map the trace once; both passes scan it in place
+        utils::TraceReader reader(trace_fp);
+        utils::TraceRecord record;
+
+        // Offline policies need every flow ID before the simulation
+        // starts. Online policies skip this pass and stream the trace.
+        if (model.requiresFutureKnowledge()) {
+            std::vector<FlowId> TraceIds;
+            while (reader.next(record)) {
+                if (!record.flow_id.empty()) {
+                    TraceIds.push_back(model.flow_ids_.intern(record.flow_id));
+                }
+            }
+            model.setTraceIds(std::move(TraceIds));
+            reader.rewind();
+        }
+        if (pipelined) {
+            utils::PipelinedTraceReader pipeline(trace_fp);
+            utils::PipelinedRecord decoded;
+            simulate(model, [&](FlowId& flow_id, uint64_t& flow_size) {
+                if (!pipeline.next(decoded)) { return false; }
+
+                // The producer assigns IDs in the same order as the
+                // table; new flows are interned to keep it in step.
+                if (!decoded.name.empty()) {
+                    const FlowId interned = model.flow_ids_.intern(decoded.name);
+                    SUPPRESS_UNUSED_WARNING(interned);
+                    assert(interned == decoded.flow_id);
+                }
+                flow_id = decoded.flow_id;
+                flow_size = decoded.flow_size;
+                return true;
+            }, packets_fp, num_warmup_cycles, root_fp, save_latencies);
+            return;
+        }
+        simulate(model, [&](FlowId& flow_id, uint64_t& flow_size) {
+            if (!reader.next(record)) { return false; }
+            flow_id = record.flow_id.empty() ? utils::kInvalidFlowId :
+                      model.flow_ids_.intern(record.flow_id);
+            flow_size = record.flow_size;
+            return true;
+        }, packets_fp, num_warmup_cycles, root_fp, save_latencies);
     }
 
     /**
-     * Run default benchmarks.
+     * Generate and output model benchmarks, replaying a decoded trace.
+     * The trace is only read, so it may be shared by concurrent runs.
+     */
+    static void benchmark(BaseCache& model, const utils::DecodedTrace& trace, const std::
+                          string& packets_fp, const size_t num_warmup_cycles, std::string root_fp,
+                          const bool save_latencies=false) {
+        // The trace's flow IDs were interned in order of first
+        // appearance, exactly as they would be by a streaming run.
+        model.shared_flow_ids_ = &trace.getFlowIds();
+
+        if (model.requiresFutureKnowledge()) {
+            std::vector<FlowId> TraceIds;
+            for (size_t idx = 0; idx < trace.size(); idx++) {
+                if (trace[idx].flow_id != utils::kInvalidFlowId) {
+                    TraceIds.push_back(trace[idx].flow_id);
+                }
+            }
+            model.setTraceIds(std::move(TraceIds));
+        }
+        size_t idx = 0;
+        simulate(model, [&](FlowId& flow_id, uint64_t& flow_size) {
+            if (idx == trace.size()) { return false; }
+            flow_id = trace[idx].flow_id;
+            flow_size = trace[idx].flow_size;
+            idx++;
+            return true;
+        }, packets_fp, num_warmup_cycles, root_fp, save_latencies);
+    }
+
+    /**
+     * Generate and output model benchmarks, simulating disjoint groups
+     * of cache sets in parallel (one group per thread).
+     *
+     * The request stream is partitioned by cache set, and each group is
+     * simulated by its own model instance (made by the given factory),
+     * which only processes its own sets' requests. Every other cycle is
+     * treated as idle, so each request still arrives on its own cycle
+     * (i.e., the global clock is preserved as the trace index), and
+     * every read completes on the same cycle as in a sequential run.
+     * The results of every group are then merged into the given model.
+     * This requires a policy with independent sets (see hasIndependentSets()).
+     */
+    template<class Factory>
+    static void benchmarkSets(BaseCache& model, const Factory& make_model,
+                              const std::string& trace_fp, size_t num_groups,
+                              const size_t num_warmup_cycles, std::string root_fp) {
+        assert(model.hasIndependentSets());
+        const utils::DecodedTrace trace(trace_fp);
+        model.shared_flow_ids_ = &trace.getFlowIds();
+
+        // Instantiate a model per group of sets
+        num_groups = std::max<size_t>(1, std::min(num_groups, model.kMaxNumCacheSets));
+        std::vector<std::unique_ptr<BaseCache>> group_models;
+        for (size_t group = 1; group < num_groups; group++) {
+            group_models.push_back(make_model());
+            group_models.back()->shared_flow_ids_ = &trace.getFlowIds();
+        }
+        // Partition the trace indices by group (set idx mod num_groups)
+        std::vector<uint32_t> flow_groups(trace.getFlowIds().size());
+        for (FlowId flow_id = 0; flow_id < flow_groups.size(); flow_id++) {
+            flow_groups[flow_id] = static_cast<uint32_t>(
+                model.getCacheIndex(flow_id) % num_groups);
+        }
+        std::vector<std::vector<size_t>> group_cycles(num_groups);
+        for (size_t idx = 0; idx < trace.size(); idx++) {
+            if (trace[idx].flow_id != utils::kInvalidFlowId) {
+                group_cycles[flow_groups[trace[idx].flow_id]].push_back(idx);
+            }
+        }
+        // Simulates a single group
+        auto simulateGroup = [&](BaseCache& group_model, const std::vector<size_t>& cycles) {
+            std::list<utils::Packet> packets; // Unused (packets are not retained)
+            const bool is_warming_up = (num_warmup_cycles < trace.size());
+            bool is_warm = false;
+            auto skipTo = [&](const size_t target_clk) {
+                if (is_warming_up && !is_warm && num_warmup_cycles <= target_clk) {
+                    group_model.skipTo(num_warmup_cycles, packets);
+                    group_model.warmupComplete();
+                    is_warm = true;
+                }
+                group_model.skipTo(target_clk, packets);
+            };
+            for (const size_t idx : cycles) {
+                skipTo(idx);
+                utils::Packet packet(trace[idx].flow_id, trace[idx].flow_size);
+                group_model.process(packet, packets);
+            }
+            skipTo(trace.size());
+            group_model.teardown(packets);
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(getOutputMutex());
+            std::cout << "Simulating " << model.kMaxNumCacheSets << " cache sets in "
+                      << num_groups << " parallel groups" << std::endl;
+        }
+        std::vector<std::exception_ptr> errors(num_groups);
+        std::vector<std::thread> workers;
+        for (size_t group = 0; group < num_groups; group++) {
+            workers.emplace_back([&, group]() {
+                try {
+                    simulateGroup((group == 0) ? model : *group_models[group - 1],
+                                  group_cycles[group]);
+                }
+                catch (...) { errors[group] = std::current_exception(); }
+            });
+        }
+        for (std::thread& worker : workers) { worker.join(); }
+        for (const std::exception_ptr& error : errors) {
+            if (error) { std::rethrow_exception(error); }
+        }
+        // Merge, and report the results
+        for (const auto& group_model : group_models) { model.mergeResults(*group_model); }
+        report(model, getResultsPath(model, root_fp));
+    }
+
+    /**
+     * Run default benchmarks. Returns the total latency, summed over
+     * every configuration (or 0 if the benchmark was not run).
+     *
+     * Several cache sizes and/or latencies may be given, in which case
+     * every combination is simulated. The trace is then decoded once
+     * into memory, and the configurations are run concurrently (one
+     * per thread) over the shared trace; each run writes the same
+     * result files as it would have if run on its own.
      */
     template<class T>
-    static void defaultBenchmark(uint64_t argc, char** argv) {
+    static size_t defaultBenchmark(uint64_t argc, char** argv) {
         using namespace boost::program_options;
 
         // Parameters
-        size_t z;
-        double c_scale;
+        std::vector<size_t> zs;
+        std::vector<double> c_scales;
         std::string trace_fp;
         std::string packets_fp;
         std::string root_fp;
         size_t set_associativity;
         size_t num_warmup_cycles;
+        size_t num_threads;
+        bool save_latencies;
+        bool pipelined;
+        bool parallel_sets;
 
         // Program options
         variables_map variables;
@@ -600,52 +899,132 @@ public:
                 ("help",        "Prints this message")
                 ("trace",       value<std::string>(&trace_fp)->required(),            "Input trace file path")
                 ("outpath",       value<std::string>(&root_fp)->required(),            "output path")
-                ("csize",      value<double>(&c_scale)->required(),                  "Parameter: Cache size (%Concurrent Flows)")
-                ("latency",     value<size_t>(&z)->required(),                        "Parameter: u")
+                ("csize",      value<std::vector<double>>(&c_scales)->multitoken()->required(), "Parameter: Cache size (%Concurrent Flows); one or more values")
+                ("latency",     value<std::vector<size_t>>(&zs)->multitoken()->required(),      "Parameter: u; one or more values")
+                ("threads",     value<size_t>(&num_threads)->default_value(0),        "[Optional] Concurrent runs, given several configurations (0: one per core)")
                 ("packets",     value<std::string>(&packets_fp)->default_value(""),   "[Optional] Output packets file path")
                 ("csa",         value<size_t>(&set_associativity)->default_value(0),  "[Optional] Parameter: Cache set-associativity")
-                ("warmup",      value<size_t>(&num_warmup_cycles)->default_value(0),  "[Optional] Parameter: Number of cache warm-up cycles");
+                ("warmup",      value<size_t>(&num_warmup_cycles)->default_value(0),  "[Optional] Parameter: Number of cache warm-up cycles")
+                ("rawlats",     bool_switch(&save_latencies),                         "[Optional] Save every request's latency to a \"_lats.txt\" file")
+                ("pipeline",    bool_switch(&pipelined),                              "[Optional] Decode the trace on a separate thread (single configuration only)")
+                ("parallelsets", bool_switch(&parallel_sets),                         "[Optional] Simulate groups of cache sets in parallel, one per thread (single configuration only)");
 
-            // Parse model parameters
-            store(parse_command_line(argc, argv, desc), variables);
+            // Parse model parameters (policy-specific
+            // parameters are parsed by the policy itself)
+            store(command_line_parser(argc, argv).options(
+                desc).allow_unregistered().run(), variables);
 
             // Handle help flag
             if (variables.count("help")) {
                 std::cout << desc << std::endl;
-                return;
+                return 0;
             }
-            store(command_line_parser(argc, argv).options(
-                desc).allow_unregistered().run(), variables);
             notify(variables);
         }
         // Flag argument errors
         catch(const required_option& e) {
             std::cerr << "Error: " << e.what() << std::endl;
-            return;
+            return 0;
         }
         catch(...) {
             std::cerr << "Unknown Error." << std::endl;
-            return;
+            return 0;
         }
 
-        // Compute the set associativity and set count
-        double cache_size = c_scale * 1024 * 1024;//(num_cfs * c_scale) / 100.0;
-        if (set_associativity == 0) { set_associativity = std::max<size_t>(
-            1, static_cast<size_t>(round(cache_size)));
+        // Every (cache size, latency) combination
+        std::vector<std::pair<double, size_t>> configs;
+        for (const double c_scale : c_scales) {
+            for (const size_t z : zs) { configs.emplace_back(c_scale, z); }
         }
-        size_t num_cache_sets = std::max<size_t>(1,
-            static_cast<size_t>(round(cache_size / set_associativity)));
-
-        // Debug: Print the cache and trace parameters
-        std::cout << std::endl;
-        std::cout << "Parameters: c=" << c_scale << ", l=" << z << std::endl;
-
-        // Instantiate the model
-        T model(z, set_associativity, num_cache_sets, true,
-                HashType::MURMUR_HASH, argc, argv);
+        if (configs.size() > 1 && !packets_fp.empty()) {
+            std::cerr << "Error: --packets requires a single configuration." << std::endl;
+            return 0;
+        }
+        if (parallel_sets && (configs.size() > 1 || save_latencies || !packets_fp.empty())) {
+            std::cerr << "Error: --parallelsets requires a single configuration, "
+                      << "and does not support --rawlats or --packets." << std::endl;
+            return 0;
+        }
+        if (num_threads == 0) { num_threads = std::thread::hardware_concurrency(); }
+
+        // Runs a single configuration, over the given shared trace
+        // (or, if there is none, streaming the trace from file).
+        auto run = [&](const std::pair<double, size_t>& config,
+                       const utils::DecodedTrace* trace) {
+            const double c_scale = config.first;
+            const size_t z = config.second;
+
+            // Compute the set associativity and set count
+            size_t csa = set_associativity;
+            double cache_size = c_scale * 1024 * 1024;//(num_cfs * c_scale) / 100.0;
+            if (csa == 0) { csa = std::max<size_t>(
+                1, static_cast<size_t>(round(cache_size)));
+            }
+            size_t num_cache_sets = std::max<size_t>(1,
+                static_cast<size_t>(round(cache_size / csa)));
+
+            // Debug: Print the cache and trace parameters
+            {
+                std::lock_guard<std::mutex> lock(getOutputMutex());
+                std::cout << std::endl;
+                std::cout << "Parameters: c=" << c_scale << ", l=" << z << std::endl;
+            }
+            // Instantiate the model
+            T model(z, csa, num_cache_sets, true,
+                    HashType::MURMUR_HASH, argc, argv);
 
-        std::cout << "Starting:" << std::endl;
-        BaseCache::benchmark(model, trace_fp, packets_fp, num_warmup_cycles,root_fp);
+            {
+                std::lock_guard<std::mutex> lock(getOutputMutex());
+                std::cout << "Starting:" << std::endl;
+            }
+            if (trace != nullptr) {
+                BaseCache::benchmark(model, *trace, packets_fp, num_warmup_cycles,
+                                     root_fp, save_latencies);
+            }
+            else if (parallel_sets && num_cache_sets > 1 && model.hasIndependentSets()) {
+                BaseCache::benchmarkSets(model, [&]() {
+                    return std::make_unique<T>(z, csa, num_cache_sets, true,
+                                               HashType::MURMUR_HASH, argc, argv);
+                }, trace_fp, num_threads, num_warmup_cycles, root_fp);
+            }
+            else {
+                BaseCache::benchmark(model, trace_fp, packets_fp, num_warmup_cycles,
+                                     root_fp, save_latencies, pipelined);
+            }
+            return model.getTotalLatency();
+        };
+
+        // A single configuration streams the trace from file
+        if (configs.size() == 1) { return run(configs[0], nullptr); }
+
+        // Else, decode the trace once, and share it between the runs
+        const utils::DecodedTrace trace(trace_fp);
+        num_threads = std::max<size_t>(1, std::min(num_threads, configs.size()));
+
+        std::atomic<size_t> next_config{0};
+        std::atomic<size_t> total_latency{0};
+        std::vector<std::exception_ptr> errors(num_threads);
+        std::vector<std::thread> workers;
+        for (size_t idx = 0; idx < num_threads; idx++) {
+            workers.emplace_back([&, idx]() {
+                try {
+                    for (size_t config = next_config++; config < configs.size();
+                         config = next_config++) {
+                        total_latency += run(configs[config], &trace);
+                    }
+                }
+                catch (...) {
+                    // Stop handing out configurations, and rethrow below
+                    errors[idx] = std::current_exception();
+                    next_config = configs.size();
+                }
+            });
+        }
+        for (std::thread& worker : workers) { worker.join(); }
+        for (const std::exception_ptr& error : errors) {
+            if (error) { std::rethrow_exception(error); }
+        }
+        return total_latency;
     }
 };
 
@@ -28,18 +28,18 @@ template<class T>
 class BeladyCacheSet : public BaseCacheSet {
 protected:
     T& cacheImpl; // Reference to the cache implementation
-    std::unordered_map<std::string, CacheEntry> entries_; // Dict mapping flow
+    std::unordered_map<FlowId, CacheEntry> entries_; // Dict mapping flow
                                                           // IDs to CacheEntries.
 public:
     BeladyCacheSet(const size_t num_entries, const size_t misslat, T& cache) :
         BaseCacheSet(num_entries, misslat), cacheImpl(cache) {}
     virtual ~BeladyCacheSet() {}
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
+    std::unordered_map<FlowId, uint64_t> Sizes1;
     uint64_t UsedSpace = 0;
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
+    update_freqs(const FlowId key, uint64_t size){
        //SUPPRESS_UNUSED_WARNING(key);
        //SUPPRESS_UNUSED_WARNING(size);
        if(Sizes1.find(key) == Sizes1.end()){
@@ -57,7 +57,7 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    write(const FlowId key, const utils::Packet& packet) override {
         SUPPRESS_UNUSED_WARNING(packet);
         CacheEntry written_entry;
 
@@ -85,9 +85,9 @@ public:
             //if (entries_.size() == getNumEntries()) {
             uint64_t count = 0;
             while(UsedSpace >= getNumEntries()){
-                const std::string evicted_key = (
+                const FlowId evicted_key = (
                     cacheImpl.getFlowIdToEvict(entries_, key, evicted));
-                assert(!evicted_key.empty());
+                assert(evicted_key != utils::kInvalidFlowId);
 
                 if(key == evicted_key){
                     evicted = 1;
@@ -130,13 +130,12 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        const utils::Packet& packet = queue.back();
-        return write(packet.getFlowId(), packet);
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId(), read.getPacket());
     }
 };
 
@@ -2,33 +2,103 @@
 #define cache_common_h
 
 // STD headers
+#include <algorithm>
+#include <array>
 #include <assert.h>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
 #include <string>
 #include <unordered_map>
-#include <numeric>
+#include <vector>
 
 // Custom headers
 #include "MurmurHash3.h"
+#include "flat_hash_map.hpp"
+#include "indexed_heap.hpp"
+#include "indexed_list.hpp"
+#include "utils.hpp"
 
 namespace caching {
 
+using utils::FlowId;
+
 /**
  * Represents a single cache entry.
  */
 class CacheEntry {
 private:
-    std::string key_; // Tag used to uniquely identify objects
+    FlowId key_ = utils::kInvalidFlowId; // Tag used to uniquely identify objects
     bool is_valid_ = false; // Whether this cache entry is valid
-    uint64_t objsize_;
 
 public:
     // Accessors
     bool isValid() const { return is_valid_; }
-    const std::string& key() const { return key_; }
+    FlowId key() const { return key_; }
 
     // Mutators
     void toggleValid() { is_valid_ = !is_valid_; }
-    void update(const std::string& key) { key_ = key; }
+    void update(const FlowId key) { key_ = key; }
+};
+
+/**
+ * Per-object metadata common to every policy.
+ */
+struct ObjectMetadata {
+    uint64_t size = 0; // Object size (as of its first request)
+    uint64_t last_request = 0; // Time of the last request
+    uint64_t num_requests = 0; // Number of requests so far
+};
+
+/**
+ * Placeholder for policies without any per-object metadata of their own.
+ */
+struct NoObjectData {};
+
+/**
+ * Implements a table of per-object metadata, indexed by FlowId.
+ *
+ * Each record holds the common ObjectMetadata followed by the policy's
+ * own fields (Extension), in a single contiguous array, so that one
+ * lookup serves every piece of state the policy keeps for an object.
+ * Every object belongs to exactly one cache set, so a single table can
+ * be shared by all the sets in a cache.
+ */
+template<class Extension=NoObjectData>
+class ObjectTable {
+public:
+    struct Record : public ObjectMetadata, public Extension {};
+
+private:
+    std::vector<Record> records_; // Object records, by FlowId
+
+public:
+    // Accessors
+    size_t size() const { return records_.size(); }
+    bool contains(const FlowId key) const { return (key < records_.size()); }
+
+    /**
+     * Returns the record for the given key, allocating (default-initialized)
+     * records up to the key if required.
+     */
+    Record& operator[](const FlowId key) {
+        if (key >= records_.size()) { records_.resize(key + 1); }
+        return records_[key];
+    }
+
+    /**
+     * Returns the (existing) record for the given key.
+     */
+    Record& at(const FlowId key) {
+        assert(contains(key));
+        return records_[key];
+    }
+    const Record& at(const FlowId key) const {
+        assert(contains(key));
+        return records_[key];
+    }
 };
 
 
@@ -38,28 +108,28 @@ public:
  */
 template<class T> class LRUQueue {
 private:
-    typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
-    std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
-                           // any time, the element at the front of the queue is the LRU entry.
+    typedef typename utils::IndexedList<T>::Index Index;
+    typedef typename utils::FlatHashMap<FlowId, Index>::iterator PositionIterator;
+    utils::FlatHashMap<FlowId, Index> positions_; // A dict mapping keys to list indices
+    utils::IndexedList<T> entries_; // An ordered list of T instances. The list is ordered such that, at
+                                    // any time, the element at the front of the queue is the LRU entry.
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
 
 public:
     // Accessors
-    std::list<T>& entries() { return entries_; }
+    utils::IndexedList<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
-    const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
+    const utils::IndexedList<T>& entries() const { return entries_; }
+    utils::FlatHashMap<FlowId, Index>& positions() { return positions_; }
+    const utils::FlatHashMap<FlowId, Index>& positions() const { return positions_; }
 
-     std::unordered_map<std::string,uint64_t> Sizes2;
+     std::unordered_map<FlowId, uint64_t> Sizes2;
 
     /**
      * Membership test.
      */
-    bool contains(const std::string& key) const {
+    bool contains(const FlowId key) const {
         return (positions_.find(key) != positions_.end());
     }
 
@@ -71,13 +141,21 @@ public:
         positions_.erase(position_iter);
     }
 
+    /**
+     * Move the given queue entry to the back of the queue.
+     */
+    void moveToBack(const PositionIterator& position_iter) {
+        entries_.moveToBack(position_iter->second);
+    }
+
     /**
      * Pop the entry at the front of the queue.
      */
     T popFront() {
-        T entry = entries_.front();
+        const Index front = entries_.front();
+        T entry = entries_[front];
         positions_.erase(getKey(entry));
-        entries_.pop_front();
+        entries_.erase(front);
         return entry;
     }
 
@@ -85,48 +163,78 @@ public:
      * Insert the given entry at the back of the queue.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
+        const FlowId key = getKey(entry);
         assert(positions_.find(key) == positions_.end());
 
-        entries_.push_back(entry);
-        positions_[key] = std::prev(entries_.end());
+        positions_.emplace(key, entries_.pushBack(entry));
     }
 };
 
 // Template specializations
-template<> const std::string&
-LRUQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+LRUQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 /**
  * Implements a parameterizable LFU queue.
+ *
+ * Entries are kept in a single list, grouped into contiguous buckets
+ * of equal frequency in increasing order of frequency; within each
+ * bucket, entries are in insertion order. The LFU entry (breaking ties
+ * in favour of the least recently inserted) is thus always at the
+ * front of the list, and insertion only requires finding the end of
+ * the entry's frequency bucket.
+ *
+ * Note: The frequency of a queued key must only change between an
+ * erase() and the following insertBack() (i.e., on a cache write).
  */
 template<class T> class LFUQueue {
 private:
     typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
+    typedef typename utils::FlatHashMap<FlowId, Iterator>::iterator PositionIterator;
+    utils::FlatHashMap<FlowId, Iterator> positions_; // A dict mapping keys to iterators
     std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
                            // any time, the element at the front of the queue is the LFU entry.
+    std::map<uint64_t, Iterator> buckets_; // A dict mapping frequencies to the first entry
+                                           // of the corresponding bucket in entries_.
+    std::vector<uint64_t> queued_freqs_; // Frequency of each key when it was queued
+
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
+
+    /**
+     * Internal helper method. Unlinks the given entry from its bucket.
+     */
+    void removeFromBucket(const Iterator& iter) {
+        const uint64_t freq = queued_freqs_[getKey(*iter)];
+        auto bucket_iter = buckets_.find(freq);
+        assert(bucket_iter != buckets_.end());
+        if (bucket_iter->second != iter) { return; }
+
+        // The entry is at the front of its bucket
+        auto next = std::next(iter);
+        if (next != entries_.end() && queued_freqs_[getKey(*next)] == freq) {
+            bucket_iter->second = next;
+        }
+        else { buckets_.erase(bucket_iter); }
+    }
 
 public:
     // Accessors
     std::list<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
     const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
+    utils::FlatHashMap<FlowId, Iterator>& positions() { return positions_; }
+    const utils::FlatHashMap<FlowId, Iterator>& positions() const { return positions_; }
 
-    std::unordered_map<std::string, uint64_t> Freqs;
-    std::unordered_map<std::string,uint64_t> Sizes2;
+    std::unordered_map<FlowId, uint64_t> Freqs;
+    std::unordered_map<FlowId, uint64_t> Sizes2;
 
 
     /**
      * Membership test.
      */
-    bool contains(const std::string& key) const {
+    bool contains(const FlowId key) const {
         return (positions_.find(key) != positions_.end());
     }
 
@@ -134,6 +242,7 @@ public:
      * Erase the given queue entry.
      */
     void erase(const PositionIterator& position_iter) {
+        removeFromBucket(position_iter->second);
         entries_.erase(position_iter->second);
         positions_.erase(position_iter);
     }
@@ -142,42 +251,35 @@ public:
      * Pop the entry at the front of the queue.
      */
     T popFreq() {
-        class std::list<T>::iterator It;
-        class std::list<T>::iterator Loc;
-        uint64_t find_val = 1000000000;
-        //uint64_t find_loc = 0;
-        T entry;
-        for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
-            uint64_t Val = Freqs[gkey];
-            if(Val < find_val){
-                find_val = Val;
-                entry = *It;
-                Loc = It;
-            }
-        }
-
-        positions_.erase(getKey(entry));
-        entries_.erase(Loc);
+        assert(!entries_.empty());
+        T entry = entries_.front();
+        erase(positions_.find(getKey(entry)));
         return entry;
     }
 
     /**
-     * Insert the given entry at the back of the queue.
+     * Insert the given entry at the back of its frequency bucket.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
+        const FlowId key = getKey(entry);
         assert(positions_.find(key) == positions_.end());
+        const uint64_t freq = Freqs[key];
 
-        entries_.push_back(entry);
-        positions_[key] = std::prev(entries_.end());
-        
+        if (key >= queued_freqs_.size()) { queued_freqs_.resize(key + 1); }
+        queued_freqs_[key] = freq;
+
+        // Insert before the first entry of the next (higher-frequency) bucket
+        auto next_bucket = buckets_.upper_bound(freq);
+        Iterator iter = entries_.insert((next_bucket == buckets_.end()) ?
+                                        entries_.end() : next_bucket->second, entry);
+        positions_[key] = iter;
+        buckets_.emplace(freq, iter); // No-op if the bucket already exists
     }
 };
 
 // Template specializations
-template<> const std::string&
-LFUQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+LFUQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 
@@ -186,28 +288,28 @@ LFUQueue<std::string>::getKey(const std::string& entry) const { return entry; }
  */
 template<class T> class FIFOQueue {
 private:
-    typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
-    std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
-                           // any time, the element at the front of the queue is the FIFO entry.
+    typedef typename utils::IndexedList<T>::Index Index;
+    typedef typename utils::FlatHashMap<FlowId, Index>::iterator PositionIterator;
+    utils::FlatHashMap<FlowId, Index> positions_; // A dict mapping keys to list indices
+    utils::IndexedList<T> entries_; // An ordered list of T instances. The list is ordered such that, at
+                                    // any time, the element at the front of the queue is the FIFO entry.
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
 
 public:
     // Accessors
-    std::list<T>& entries() { return entries_; }
+    utils::IndexedList<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
-    const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
+    const utils::IndexedList<T>& entries() const { return entries_; }
+    utils::FlatHashMap<FlowId, Index>& positions() { return positions_; }
+    const utils::FlatHashMap<FlowId, Index>& positions() const { return positions_; }
 
-    std::unordered_map<std::string,uint64_t> Sizes2;
+    std::unordered_map<FlowId, uint64_t> Sizes2;
 
     /**
      * Membership test.
      */
-    bool contains(const std::string& key) const {
+    bool contains(const FlowId key) const {
         return (positions_.find(key) != positions_.end());
     }
 
@@ -223,9 +325,10 @@ public:
      * Pop the entry at the front of the queue.
      */
     T popFront() {
-        T entry = entries_.front();
+        const Index front = entries_.front();
+        T entry = entries_[front];
         positions_.erase(getKey(entry));
-        entries_.pop_front();
+        entries_.erase(front);
         return entry;
     }
 
@@ -233,146 +336,382 @@ public:
      * Insert the given entry at the back of the queue.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
+        const FlowId key = getKey(entry);
         assert(positions_.find(key) == positions_.end());
 
-        entries_.push_back(entry);
-        positions_[key] = std::prev(entries_.end());
+        positions_.emplace(key, entries_.pushBack(entry));
     }
 };
 
 // Template specializations
-template<> const std::string&
-FIFOQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+FIFOQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 
-/*
-Class for PB-LRU
-*/
-class InTimes{
+/**
+ * Estimates a flow's arrival rate (lambda) from its inter-arrival
+ * times, in O(1) time and space per arrival. The estimate is either
+ * the inverse of the mean of the last kWindowSize inter-arrival times
+ * (kept in a ring buffer, with a running sum), or the inverse of their
+ * EWMA. Until kMinSamples inter-arrival times have been recorded, the
+ * rate is taken to be (effectively) zero.
+ */
+class InTimes {
+public:
+    enum class Mode { kWindow, kEWMA };
+    static constexpr size_t kWindowSize = 20;
+    static constexpr size_t kMinSamples = 3;
+    static constexpr double kDefaultLambda = 0.00000001;
+
+    /**
+     * Estimator parameters, shared by every flow in a queue.
+     */
+    struct Config {
+        Mode mode = Mode::kWindow;
+        double ewma_alpha = 2.0 / (kWindowSize + 1); // Weight of the newest sample
+    };
+
 private:
-    double num_windows_ = 0;
-    double cumulative_itimes_ = 0;
+    std::array<double, kWindowSize> itimes_{}; // Ring buffer of inter-arrival times
+    double sum_ = 0; // Sum of the buffered inter-arrival times (or their EWMA)
+    uint32_t num_samples_ = 0; // Number of recorded inter-arrival times (saturating)
+    uint32_t head_ = 0; // Ring buffer index of the oldest inter-arrival time
 
 public:
-    uint64_t L = 20;
-    std::list<double> CTimes;
     /**
-     * Records a packet arrival corresponding to this flow.
-     */
-    void recordArrivTimes(double itime) {
-        //num_windows_++;
-        //cumulative_itimes_ += itime;
-        CTimes.push_back(itime);
-        if(CTimes.size() > L){
-            CTimes.pop_front();
+     * Records an inter-arrival time corresponding to this flow.
+     */
+    void recordArrivTimes(const double itime, const Config& config) {
+        if (config.mode == Mode::kEWMA) {
+            sum_ = (num_samples_ == 0) ? itime : (config.ewma_alpha * itime +
+                                                  (1 - config.ewma_alpha) * sum_);
+        }
+        else if (num_samples_ < kWindowSize) {
+            itimes_[num_samples_] = itime;
+            sum_ += itime;
         }
+        else {
+            sum_ += itime - itimes_[head_];
+            itimes_[head_] = itime;
+            head_ = (head_ + 1) % kWindowSize;
+        }
+        if (num_samples_ < std::numeric_limits<uint32_t>::max()) { num_samples_++; }
     }
+
     /**
-     * Returns the payoff for this flow.
+     * Returns the arrival rate for this flow.
      */
-    double getLambda() {
-        double Lamb = 0.00000001;
-        if(CTimes.size() >= 3){
-            double Sum = std::accumulate(CTimes.begin(),CTimes.end(),0);
-            Lamb = 1.0 / (Sum / (double)CTimes.size());
-        }
-        return Lamb;
+    double getLambda(const Config& config) const {
+        if (num_samples_ < kMinSamples) { return kDefaultLambda; }
+        if (config.mode == Mode::kEWMA) { return 1.0 / sum_; }
+
+        const size_t num_buffered = std::min<size_t>(num_samples_, kWindowSize);
+        return 1.0 / (sum_ / static_cast<double>(num_buffered));
     }
 };
 
 
 
 /**
- * Implements a parameterizable PBLRU2 queue.
+ * Implements a parameterizable LA (latency-aware) queue.
+ *
+ * The eviction score of an entry depends on its arrival rate (lambda),
+ * its size, and, once the entry has been idle for longer than 12 mean
+ * inter-arrival times ("stale"), on the time since its last request.
+ * Scores of the remaining ("fresh") entries do not change over time,
+ * so they are kept in an indexed min-heap and only re-keyed when the
+ * entry is requested. Fresh entries move to the stale set when their
+ * deadline (in Timer ticks) passes. Stale scores decay over time, so
+ * they are evaluated at eviction time, in increasing order of a lower
+ * bound on the score; the scan stops as soon as no remaining entry can
+ * beat the current victim. Ties are broken in queue order, exactly as
+ * in a linear scan.
+ *
+ * Alternatively (see setSampleSize()), eviction can be approximated by
+ * scoring K randomly-sampled entries and evicting the lowest-scoring
+ * one, in O(K) time regardless of the queue size.
+ *
+ * Every piece of per-object state (size, last request time, arrival
+ * rate, and queue position) lives in a single ObjectTable record.
  */
 template<class T> class PBSQueue {
 private:
     typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
+    typedef std::pair<double, uint64_t> Score; // (Eviction score, insertion sequence)
+    static constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+public:
+    /**
+     * Per-object LA metadata.
+     */
+    struct ObjectData {
+        double lambda = 0; // Arrival rate estimate
+        uint64_t sequence = 0; // Insertion sequence (used to break ties in queue order)
+        size_t slot = 0; // Index in the dense slots array (if queued)
+        Iterator position; // Position in the queue (if queued)
+        bool is_queued = false; // Whether the object is queued
+        InTimes inter_times; // Arrival rate estimator
+    };
+    typedef ObjectTable<ObjectData> Objects;
+    typedef typename Objects::Record Object;
+
+private:
+    Objects& objects_; // Per-object metadata (possibly shared with other queues)
     std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
-                           // any time, the element at the front of the queue is the LFU entry.
+                           // any time, the element at the front of the queue is the LRU entry.
+    uint64_t num_insertions_ = 0; // Insertion counter (used to break ties in queue order)
+    utils::IndexedHeap<Score> fresh_; // Fresh entries, ordered by score
+    utils::IndexedHeap<uint64_t> deadlines_; // Fresh entries, ordered by when they turn stale
+    std::set<std::pair<double, FlowId>> stale_; // Stale entries, ordered by score bound
+
+    size_t sample_size_ = 0; // Entries sampled per eviction (0 = exact eviction)
+    std::vector<FlowId> slots_; // Dense array of queued keys (for sampling)
+    std::mt19937_64 generator_; // Sampling PRNG (fixed seed)
+    InTimes::Config rate_config_; // Arrival rate estimator parameters
+
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
+
+    /**
+     * Internal helper method. Whether the given object is stale at time t.
+     */
+    bool isStaleAt(const Object& object, const uint64_t t) const {
+        double lrt = t - object.last_request + 1.0;
+        return (use2 && lrt >= 12.0 * 1.0 / object.lambda);
+    }
+
+    /**
+     * Internal helper method. Returns the time at which the given
+     * object turns stale, or kNever if it never does.
+     */
+    uint64_t getStaleDeadline(const Object& object) const {
+        if (!use2) { return kNever; }
+        const uint64_t lrt = object.last_request;
+        const double threshold = 12.0 * 1.0 / object.lambda;
+        if (!(threshold > 1.0)) { return lrt; }
+        if (threshold > 1e18) { return kNever; }
+
+        // Find the first tick satisfying the (floating-point) condition
+        uint64_t idle = static_cast<uint64_t>(std::ceil(threshold - 1.0));
+        while (!isStaleAt(object, lrt + idle)) { idle++; }
+        while (idle > 0 && isStaleAt(object, lrt + idle - 1)) { idle--; }
+        return lrt + idle;
+    }
+
+    /**
+     * Internal helper method. Returns a lower bound on the score of the
+     * given (stale) object at any time up to now, divided by (Timer + 1).
+     */
+    double getScoreBound(const Object& object) const {
+        double size = object.size + 1.0;
+        return (MissLatency + size * 1000 / BWidth) / 2.0 / size;
+    }
+
+    /**
+     * Internal helper method. Returns the current score of the given object.
+     */
+    double getScore(const Object& object) const {
+        double lrt = Timer - object.last_request + 1.0;
+        double size = object.size + 1.0;
+        double glambda = object.lambda;
+        if(use2 && lrt >= 12.0 * 1.0 / object.lambda){ glambda = 1.0 / lrt;}
+        double LT = glambda * (MissLatency + size * 1000 / BWidth);
+        return LT * (LT + 1) / (LT + 2) / 1.0 / size;
+    }
+
+    /**
+     * Internal helper method. (Re-)indexes the given queued key.
+     */
+    void index(const FlowId key, const Object& object) {
+        if (sample_size_ > 0) { return; }
+        unindex(key, object);
+        const uint64_t deadline = getStaleDeadline(object);
+        if (deadline <= Timer) {
+            stale_.emplace(getScoreBound(object), key);
+        }
+        else {
+            fresh_.push(key, Score(getScore(object), object.sequence));
+            if (deadline != kNever) { deadlines_.push(key, deadline); }
+        }
+    }
+
+    /**
+     * Internal helper method. Removes the given key from the index.
+     */
+    void unindex(const FlowId key, const Object& object) {
+        if (sample_size_ > 0) { return; }
+        if (fresh_.contains(key)) {
+            fresh_.erase(key);
+            deadlines_.erase(key);
+        }
+        else { stale_.erase(std::make_pair(getScoreBound(object), key)); }
+    }
+
+    /**
+     * Internal helper methods. Add or remove the given key from the
+     * dense slots array (removal swaps it with the last slot).
+     */
+    void addSlot(const FlowId key, Object& object) {
+        object.slot = slots_.size();
+        slots_.push_back(key);
+    }
+    void removeSlot(const Object& object) {
+        const size_t idx = object.slot;
+        slots_[idx] = slots_.back();
+        objects_.at(slots_[idx]).slot = idx;
+        slots_.pop_back();
+    }
+
+    /**
+     * Internal helper method. Returns the lowest-scoring
+     * of sample_size_ randomly-sampled queued keys.
+     */
+    FlowId getSampledVictim() {
+        std::uniform_int_distribution<size_t> distribution(0, slots_.size() - 1);
+        FlowId victim = utils::kInvalidFlowId;
+        Score best(std::numeric_limits<double>::max(), kNever);
+        for (size_t idx = 0; idx < sample_size_; idx++) {
+            const FlowId key = slots_[distribution(generator_)];
+            const Object& object = objects_.at(key);
+            const Score score(getScore(object), object.sequence);
+            if (victim == utils::kInvalidFlowId || score < best) {
+                best = score;
+                victim = key;
+            }
+        }
+        return victim;
+    }
+
+    /**
+     * Internal helper method. Returns the lowest-scoring queued key.
+     */
+    FlowId getExactVictim() {
+        refreshStale();
+
+        // The best fresh entry
+        FlowId victim = utils::kInvalidFlowId;
+        Score best(std::numeric_limits<double>::max(), kNever);
+        if (!fresh_.empty()) {
+            best = fresh_.top().first;
+            victim = fresh_.top().second;
+        }
+        // Stale entries which may beat it. Every stale score is at
+        // least (bound / (Timer + 1)); the margin absorbs rounding.
+        const double horizon = Timer + 1.0;
+        for (const auto& element : stale_) {
+            if (victim != utils::kInvalidFlowId && (element.first / horizon) >
+                best.first + std::fabs(best.first) * 1e-9) { break; }
+
+            const Object& object = objects_.at(element.second);
+            const Score score(getScore(object), object.sequence);
+            if (score < best) {
+                best = score;
+                victim = element.second;
+            }
+        }
+        return victim;
+    }
+
+    /**
+     * Internal helper method. Moves the entries whose deadline has
+     * passed from the fresh heap to the stale set.
+     */
+    void refreshStale() {
+        while (!deadlines_.empty() && deadlines_.top().first <= Timer) {
+            const FlowId key = deadlines_.pop();
+            fresh_.erase(key);
+            stale_.emplace(getScoreBound(objects_.at(key)), key);
+        }
+    }
 
 public:
+    explicit PBSQueue(Objects& objects) : objects_(objects) {}
+
     // Accessors
     std::list<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
     const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
+    const Object& getObject(const FlowId key) const { return objects_.at(key); }
 
-    std::unordered_map<std::string, uint64_t> Freqs;//记录元素的频率
     uint64_t MissLatency;
     uint64_t Timer = 0;
     double BWidth = 104857600.0;
-    std::unordered_map<std::string,uint64_t> LRTs;
-    std::unordered_map<std::string,InTimes> InterTimes;
-    std::unordered_map<std::string,double> Lambdas;
-    std::unordered_map<std::string,uint64_t> Sizes2;
-    std::unordered_map<std::string,double> EvictRules;
     bool use2 = false;
 
 
     void set_Z(const size_t misslat){MissLatency = misslat; if(misslat <= 1000000){use2=true;}}
 
     /**
-     * Membership test.
+     * Sets the number of entries sampled per eviction (0 for exact
+     * eviction). Must be called before any entries are inserted.
      */
-    bool contains(const std::string& key) const {
-        return (positions_.find(key) != positions_.end());
+    void setSampleSize(const size_t sample_size) {
+        assert(entries_.empty());
+        sample_size_ = sample_size;
     }
 
     /**
-     * Erase the given queue entry.
+     * Sets the arrival rate estimator parameters. Must be
+     * called before any arrivals are recorded.
      */
-    void erase(const PositionIterator& position_iter) {
-        entries_.erase(position_iter->second);
-        positions_.erase(position_iter);
+    void setRateConfig(const InTimes::Config& config) {
+        assert(Timer == 0);
+        rate_config_ = config;
     }
 
-     /*
-     update eviction rules
+    /**
+     * Membership test.
      */
-    void update_evict(){
-         class std::list<T>::iterator It;
-         for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
-            double lrt = Timer - LRTs[gkey] + 1.0;
-            double size = Sizes2[gkey] + 1.0;
-            double glambda = Lambdas[gkey];
-            if(use2 && lrt >= 12.0 * 1.0 / Lambdas[gkey]){ glambda = 1.0 / lrt;}
-            double LT = glambda * (MissLatency + size * 1000 / BWidth);
-            double Val = LT * (LT + 1) / (LT + 2) / 1.0 / size;
-            //if(use2){Val = Val / lrt / 1.0;}
-            EvictRules[gkey] = Val;
-          }
-     }
-    
+    bool contains(const FlowId key) const {
+        return (objects_.contains(key) && objects_.at(key).is_queued);
+    }
 
     /**
-     * Pop the entry at the front of the queue.
+     * Records a request to the given key, updating its arrival rate
+     * and last request time (and, if it is queued, its score). The
+     * size is recorded on the first request only.
      */
-    T popMin() {
-        class std::list<T>::iterator It;
-        class std::list<T>::iterator Loc;
-        double find_val = std::numeric_limits<double>::max();
-        T entry;
-        for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
-            double Val = EvictRules[gkey];
-            if(Val < find_val){
-                find_val = Val;
-                entry = *It;
-                Loc = It;
-            }
+    void recordArrival(const FlowId key, const uint64_t size) {
+        Object& object = objects_[key];
+        if(object.num_requests > 0){
+            double intertime = (Timer - object.last_request) / 1.0;
+            object.inter_times.recordArrivTimes(intertime, rate_config_);
+            object.lambda = object.inter_times.getLambda(rate_config_);
         }
+        else{
+            object.lambda = 0.0;
+            object.size = size;
+        }
+        object.last_request = Timer;
+        object.num_requests++;
+        Timer++;
 
-        positions_.erase(getKey(entry));
-        entries_.erase(Loc);
+        if (object.is_queued) { index(key, object); }
+    }
+
+    /**
+     * Erase the given (queued) key.
+     */
+    void erase(const FlowId key) {
+        Object& object = objects_.at(key);
+        assert(object.is_queued);
+        unindex(key, object);
+        removeSlot(object);
+        entries_.erase(object.position);
+        object.is_queued = false;
+    }
+
+    /**
+     * Pop the entry with the lowest score (or, if sampling,
+     * the lowest score among the sampled entries).
+     */
+    T popMin() {
+        const FlowId victim = (sample_size_ > 0) ? getSampledVictim() :
+                                                   getExactVictim();
+        assert(contains(victim));
+        T entry = *(objects_.at(victim).position);
+        erase(victim);
         return entry;
     }
 
@@ -380,17 +719,21 @@ public:
      * Insert the given entry at the back of the queue.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
-        assert(positions_.find(key) == positions_.end());
-
-        entries_.push_back(entry);
-        positions_[key] = std::prev(entries_.end());
+        const FlowId key = getKey(entry);
+        Object& object = objects_[key];
+        assert(!object.is_queued);
+
+        object.position = entries_.insert(entries_.end(), entry);
+        object.is_queued = true;
+        object.sequence = num_insertions_++;
+        addSlot(key, object);
+        index(key, object);
     }
 };
 
 // Template specializations
-template<> const std::string&
-PBSQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+PBSQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 
@@ -400,29 +743,29 @@ PBSQueue<std::string>::getKey(const std::string& entry) const { return entry; }
 template<class T> class PBLQueue {
 private:
     typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
+    typedef typename utils::FlatHashMap<FlowId, Iterator>::iterator PositionIterator;
+    utils::FlatHashMap<FlowId, Iterator> positions_; // A dict mapping keys to iterators
     std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
                            // any time, the element at the front of the queue is the LFU entry.
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
 
 public:
     // Accessors
     std::list<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
     const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
+    utils::FlatHashMap<FlowId, Iterator>& positions() { return positions_; }
+    const utils::FlatHashMap<FlowId, Iterator>& positions() const { return positions_; }
     
     uint64_t MissLatency;
     uint64_t Timer = 0;
     double BWidth = 104857600.0;
-    std::unordered_map<std::string,uint64_t> LRTs;
-    std::unordered_map<std::string,InTimes> InterTimes;
-    std::unordered_map<std::string,double> Lambdas;
-    std::unordered_map<std::string,uint64_t> Sizes2;
-    std::unordered_map<std::string,double> EvictRules;
+    std::unordered_map<FlowId, uint64_t> LRTs;
+    std::unordered_map<FlowId, InTimes> InterTimes;
+    std::unordered_map<FlowId, double> Lambdas;
+    std::unordered_map<FlowId, uint64_t> Sizes2;
+    std::unordered_map<FlowId, double> EvictRules;
 
 
     void set_Z(const size_t misslat){MissLatency = misslat;}
@@ -430,7 +773,7 @@ public:
     /**
      * Membership test.
      */
-    bool contains(const std::string& key) const {
+    bool contains(const FlowId key) const {
         return (positions_.find(key) != positions_.end());
     }
 
@@ -448,7 +791,7 @@ public:
     void update_evict(){
          class std::list<T>::iterator It;
          for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
+            FlowId gkey = getKey(*It);
             double lrt = Timer - LRTs[gkey] + 1.0;
             double size = Sizes2[gkey] + 1.0;
             double LT = Lambdas[gkey] * (MissLatency + size * 1000 / BWidth);
@@ -467,7 +810,7 @@ public:
         double find_val = std::numeric_limits<double>::max();
         T entry;
         for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
+            FlowId gkey = getKey(*It);
             double Val = EvictRules[gkey];
             if(Val < find_val){
                 find_val = Val;
@@ -485,7 +828,7 @@ public:
      * Insert the given entry at the back of the queue.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
+        const FlowId key = getKey(entry);
         assert(positions_.find(key) == positions_.end());
 
         entries_.push_back(entry);
@@ -494,86 +837,96 @@ public:
 };
 
 // Template specializations
-template<> const std::string&
-PBLQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+PBLQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 
 /**
  * Implements a parameterizable Belady queue.
+ *
+ * The absolute index of the next request following every request is
+ * precomputed in a single backward pass over the trace. Queued keys
+ * are kept in an indexed max-heap ordered by their next request index;
+ * keys which are never requested again share the same index (MaxLim),
+ * and ties are broken in favour of the least recently inserted entry.
  */
 template<class T> class BeladyQueue {
 private:
     typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
-    std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
-                           // any time, the element at the front of the queue is the LFU entry.
+    typedef typename utils::FlatHashMap<FlowId, Iterator>::iterator PositionIterator;
+    typedef std::pair<uint64_t, uint64_t> Priority; // (Next request index, insertion sequence)
+
+    /**
+     * Orders entries by furthest next request, then earliest insertion.
+     */
+    struct FurthestFirst {
+        bool operator()(const Priority& a, const Priority& b) const {
+            return (a.first > b.first) || (a.first == b.first && a.second < b.second);
+        }
+    };
+    utils::FlatHashMap<FlowId, Iterator> positions_; // A dict mapping keys to iterators
+    std::list<T> entries_; // An ordered list of T instances, in insertion order
+    std::vector<uint64_t> next_requests_; // Index of the next request following each request
+    std::vector<uint64_t> key_next_requests_; // Next request index of each key
+    uint64_t num_insertions_ = 0; // Insertion counter (used to break ties)
+    utils::IndexedHeap<Priority, FurthestFirst> heap_; // Queued keys, furthest next request first
+
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
 
 public:
     // Accessors
     std::list<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
     const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
-
-    std::vector<std::string> Trace;
-    std::unordered_map<std::string,uint64_t> Counter;
-    std::unordered_map<std::string,std::vector<uint64_t>> ReqTimes;
-    std::unordered_map<std::string,uint64_t> NRTs;
-    std::unordered_map<std::string,uint64_t> Sizes;
+    utils::FlatHashMap<FlowId, Iterator>& positions() { return positions_; }
+    const utils::FlatHashMap<FlowId, Iterator>& positions() const { return positions_; }
+
+    std::unordered_map<FlowId, uint64_t> Sizes;
     uint64_t MaxLim = 1000000000;
     uint64_t Timenow = -1;
 
-    void setTrace(std::vector<std::string> Ids){Trace = Ids;}
- 
-    void process(){
-        uint64_t gtime = 0;
-        for(uint64_t i=0;i<Trace.size();i++){
-            std::string gky = Trace[i];
-            if(ReqTimes.find(gky) != ReqTimes.end()){
-                ReqTimes[gky].push_back(gtime);
-            }
-            else{
-                Counter[gky] = 0;
-                std::vector<uint64_t> GT;
-                GT.push_back(gtime);
-                ReqTimes[gky] = GT;
-            }
-            gtime++;
-        }
-
-        std::unordered_map<std::string,std::vector<uint64_t>>::iterator It;
-        for(It = ReqTimes.begin();It != ReqTimes.end(); It++){
-            std::string gky = It->first;
-            ReqTimes[gky].push_back(MaxLim);
+    /**
+     * Computes the next request index following every request in the
+     * given trace (or MaxLim if the object is never requested again).
+     */
+    void setTrace(const std::vector<FlowId>& Ids){
+        next_requests_.assign(Ids.size(), MaxLim);
+        std::vector<uint64_t> last_requests;
+        for (uint64_t i = Ids.size(); i-- > 0;) {
+            const FlowId gky = Ids[i];
+            if (gky >= last_requests.size()) { last_requests.resize(gky + 1, MaxLim); }
+            next_requests_[i] = last_requests[gky];
+            last_requests[gky] = i;
         }
+        key_next_requests_.assign(last_requests.size(), MaxLim);
     }
 
-    void updateNRTs(std::string Ky){
+    /**
+     * Records the next request to the given key.
+     */
+    void updateNRTs(const FlowId Ky){
         Timenow++;
-        Counter[Ky]++;
-        uint64_t ky_nrt = ReqTimes[Ky][Counter[Ky]] - Timenow + 1;
-        NRTs[Ky] = ky_nrt;
-        
-        std::unordered_map<std::string,uint64_t>::iterator It;
-        for(It = NRTs.begin();It != NRTs.end(); It++){
-            std::string gky = It->first;
-            uint64_t gval = NRTs[gky];
-            if(gval != MaxLim){
-                NRTs[gky] = gval - 1;
-            }
-         }
-        //std::cout<<"Update Finished..."<<std::endl;
+        assert(Timenow < next_requests_.size());
+        uint64_t next_request = next_requests_[Timenow];
+
+        // A distance of exactly MaxLim is never decremented, i.e.,
+        // the key sorts after every other (see the original scan).
+        if (next_request - Timenow + 1 == MaxLim) {
+            next_request = std::numeric_limits<uint64_t>::max();
+        }
+        key_next_requests_[Ky] = next_request;
+
+        if (heap_.contains(Ky)) {
+            heap_.update(Ky, Priority(next_request, heap_.priority(Ky).second));
+        }
     }
 
     /**
      * Membership test.
      */
-    bool contains(const std::string& key) const {
+    bool contains(const FlowId key) const {
         return (positions_.find(key) != positions_.end());
     }
 
@@ -581,34 +934,19 @@ public:
      * Erase the given queue entry.
      */
     void erase(const PositionIterator& position_iter) {
+        heap_.erase(position_iter->first);
         entries_.erase(position_iter->second);
         positions_.erase(position_iter);
     }
 
      /**
-     * Pop the entry at the front of the queue.
+     * Pop the entry whose next request is furthest in the future.
      */
     T popMax() {
-        class std::list<T>::iterator It;
-        class std::list<T>::iterator Loc;
-        double find_val = -1.0;
-        T entry;
-        for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
-            double Val = NRTs[gkey] / 1.0;
-            if(Val > find_val){
-                find_val = Val;
-                entry = *It;
-                Loc = It;
-            }
-            if(Val <= 0){
-                std::cout<<gkey<<" "<<Val<<std::endl;
-            }
-        }
-
-        positions_.erase(getKey(entry));
-        NRTs.erase(getKey(entry));
-        entries_.erase(Loc);
+        auto position_iter = positions_.find(heap_.top().second);
+        assert(position_iter != positions_.end());
+        T entry = *(position_iter->second);
+        erase(position_iter);
         return entry;
     }
 
@@ -617,17 +955,18 @@ public:
      * Insert the given entry at the back of the queue.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
+        const FlowId key = getKey(entry);
         assert(positions_.find(key) == positions_.end());
 
         entries_.push_back(entry);
         positions_[key] = std::prev(entries_.end());
+        heap_.push(key, Priority(key_next_requests_[key], num_insertions_++));
     }
 };
 
 // Template specializations
-template<> const std::string&
-BeladyQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+BeladyQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 
@@ -637,35 +976,35 @@ BeladyQueue<std::string>::getKey(const std::string& entry) const { return entry;
 template<class T> class BeladySQueue {
 private:
     typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
+    typedef typename utils::FlatHashMap<FlowId, Iterator>::iterator PositionIterator;
+    utils::FlatHashMap<FlowId, Iterator> positions_; // A dict mapping keys to iterators
     std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
                            // any time, the element at the front of the queue is the LFU entry.
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
 
 public:
     // Accessors
     std::list<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
     const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
-
-    std::vector<std::string> Trace;
-    std::unordered_map<std::string,uint64_t> Counter;
-    std::unordered_map<std::string,std::vector<uint64_t>> ReqTimes;
-    std::unordered_map<std::string,uint64_t> NRTs;
-    std::unordered_map<std::string,uint64_t> Sizes;
+    utils::FlatHashMap<FlowId, Iterator>& positions() { return positions_; }
+    const utils::FlatHashMap<FlowId, Iterator>& positions() const { return positions_; }
+
+    std::vector<FlowId> Trace;
+    std::unordered_map<FlowId, uint64_t> Counter;
+    std::unordered_map<FlowId, std::vector<uint64_t>> ReqTimes;
+    std::unordered_map<FlowId, uint64_t> NRTs;
+    std::unordered_map<FlowId, uint64_t> Sizes;
     uint64_t MaxLim = 1000000000;
     uint64_t Timenow = -1;
 
-    void setTrace(std::vector<std::string> Ids){Trace = Ids;}
+    void setTrace(const std::vector<FlowId>& Ids){Trace = Ids;}
  
     void process(){
         uint64_t gtime = 0;
         for(uint64_t i=0;i<Trace.size();i++){
-            std::string gky = Trace[i];
+            FlowId gky = Trace[i];
             if(ReqTimes.find(gky) != ReqTimes.end()){
                 ReqTimes[gky].push_back(gtime);
             }
@@ -678,22 +1017,25 @@ public:
             gtime++;
         }
 
-        std::unordered_map<std::string,std::vector<uint64_t>>::iterator It;
+        std::unordered_map<FlowId, std::vector<uint64_t>>::iterator It;
         for(It = ReqTimes.begin();It != ReqTimes.end(); It++){
-            std::string gky = It->first;
+            FlowId gky = It->first;
             ReqTimes[gky].push_back(MaxLim);
         }
+
+        // The request times are all we need from here on
+        std::vector<FlowId>().swap(Trace);
     }
 
-    void updateNRTs(std::string Ky){
+    void updateNRTs(const FlowId Ky){
         Timenow++;
         Counter[Ky]++;
         uint64_t ky_nrt = ReqTimes[Ky][Counter[Ky]] - Timenow + 1;
         NRTs[Ky] = ky_nrt;
         
-        std::unordered_map<std::string,uint64_t>::iterator It;
+        std::unordered_map<FlowId, uint64_t>::iterator It;
         for(It = NRTs.begin();It != NRTs.end(); It++){
-            std::string gky = It->first;
+            FlowId gky = It->first;
             uint64_t gval = NRTs[gky];
             if(gval != MaxLim){
                 NRTs[gky] = gval - 1;
@@ -705,7 +1047,7 @@ public:
     /**
      * Membership test.
      */
-    bool contains(const std::string& key) const {
+    bool contains(const FlowId key) const {
         return (positions_.find(key) != positions_.end());
     }
 
@@ -726,7 +1068,7 @@ public:
         double find_val = -1.0;
         T entry;
         for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
+            FlowId gkey = getKey(*It);
             double Val = NRTs[gkey] / 1.0 * Sizes[gkey];
             if(Val > find_val){
                 find_val = Val;
@@ -749,7 +1091,7 @@ public:
      * Insert the given entry at the back of the queue.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
+        const FlowId key = getKey(entry);
         assert(positions_.find(key) == positions_.end());
 
         entries_.push_back(entry);
@@ -758,41 +1100,66 @@ public:
 };
 
 // Template specializations
-template<> const std::string&
-BeladySQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+BeladySQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 
 /**
- * Implements a parameterizable FIFO queue.
+ * Implements a parameterizable LRU-K queue.
+ *
+ * Only the last K request times of every key are kept, in a fixed-size
+ * ring per key. Queued keys are kept in an indexed min-heap ordered by
+ * their K-th most recent request time, so the entry with the largest
+ * backward K-distance is always at the top of the heap. Request times
+ * are unique, so there are no ties.
  */
 template<class T> class LRUKQueue {
 private:
     typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
-    std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
-                           // any time, the element at the front of the queue is the FIFO entry.
+    typedef typename utils::FlatHashMap<FlowId, Iterator>::iterator PositionIterator;
+    utils::FlatHashMap<FlowId, Iterator> positions_; // A dict mapping keys to iterators
+    std::list<T> entries_; // An ordered list of T instances, in insertion order
+    std::vector<uint64_t> request_times_; // Ring of the last K request times of each key
+    std::vector<uint64_t> num_requests_; // Total number of requests to each key
+    utils::IndexedHeap<uint64_t> kth_request_times_; // Queued keys, ordered by their
+                                                     // K-th most recent request time.
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
+
+    /**
+     * Internal helper method. Returns the K-th most
+     * recent request time of the given key.
+     */
+    uint64_t getKthRequestTime(const FlowId key) const {
+        assert(num_requests_[key] >= K);
+        return request_times_[(key * K) + ((num_requests_[key] - K) % K)];
+    }
 
 public:
     // Accessors
     std::list<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
     const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
+    utils::FlatHashMap<FlowId, Iterator>& positions() { return positions_; }
+    const utils::FlatHashMap<FlowId, Iterator>& positions() const { return positions_; }
 
-    std::unordered_map<std::string,uint64_t> Sizes2;
-    std::unordered_map<std::string,std::vector<uint64_t>> LRTs;
+    std::unordered_map<FlowId, uint64_t> Sizes2;
     uint64_t Timer = 0;
     uint64_t K = 4;
 
+    /**
+     * Sets K. Must be called before any requests are recorded.
+     */
+    void setK(const uint64_t k) {
+        assert(k > 0 && num_requests_.empty());
+        K = k;
+    }
+
     /**
      * Membership test.
      */
-    bool contains(const std::string& key) const {
+    bool contains(const FlowId key) const {
         return (positions_.find(key) != positions_.end());
     }
 
@@ -800,44 +1167,33 @@ public:
      * Erase the given queue entry.
      */
     void erase(const PositionIterator& position_iter) {
+        kth_request_times_.erase(position_iter->first);
         entries_.erase(position_iter->second);
         positions_.erase(position_iter);
     }
 
-    void update_lrts(std::string key){
-        if(LRTs.find(key) == LRTs.end()){
-            std::vector<uint64_t> lrts;
-            lrts.push_back(Timer);
-            LRTs[key] = lrts;
-        }
-        else{
-           LRTs[key].push_back(Timer);
+    void update_lrts(const FlowId key){
+        if (key >= num_requests_.size()) {
+            num_requests_.resize(key + 1, 0);
+            request_times_.resize((key + 1) * K);
         }
+        request_times_[(key * K) + (num_requests_[key] % K)] = Timer;
+        num_requests_[key]++;
         Timer++;
+
+        if (kth_request_times_.contains(key)) {
+            kth_request_times_.update(key, getKthRequestTime(key));
+        }
     }
 
     /**
-     * Pop the entry at the front of the queue.
+     * Pop the entry with the largest backward K-distance.
      */
     T popFront() {
-        class std::list<T>::iterator It;
-        class std::list<T>::iterator Loc;
-        uint64_t find_val = 0;
-        T entry;
-        for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
-            std::vector<uint64_t> glrts = LRTs[gkey];
-            uint64_t L = glrts.size() - K;
-            uint64_t Val = Timer - glrts[L];
-            if(Val > find_val){
-                find_val = Val;
-                entry = *It;
-                Loc = It;
-            }
-        }
-
-        positions_.erase(getKey(entry));
-        entries_.erase(Loc);
+        auto position_iter = positions_.find(kth_request_times_.top().second);
+        assert(position_iter != positions_.end());
+        T entry = *(position_iter->second);
+        erase(position_iter);
         return entry;
     }
 
@@ -845,17 +1201,18 @@ public:
      * Insert the given entry at the back of the queue.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
+        const FlowId key = getKey(entry);
         assert(positions_.find(key) == positions_.end());
 
         entries_.push_back(entry);
         positions_[key] = std::prev(entries_.end());
+        kth_request_times_.push(key, getKthRequestTime(key));
     }
 };
 
 // Template specializations
-template<> const std::string&
-LRUKQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+LRUKQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 
@@ -866,29 +1223,29 @@ LRUKQueue<std::string>::getKey(const std::string& entry) const { return entry; }
  */
 template<class T> class TQQueue {
 private:
-    typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::unordered_map<std::string, Iterator>::iterator PositionIterator;
-    std::unordered_map<std::string, Iterator> positions_; // A dict mapping keys to iterators
-    std::list<T> entries_; // An ordered list of T instances. The list is ordered such that, at
-                           // any time, the element at the front of the queue is the FIFO entry.
+    typedef typename utils::IndexedList<T>::Index Index;
+    typedef typename utils::FlatHashMap<FlowId, Index>::iterator PositionIterator;
+    utils::FlatHashMap<FlowId, Index> positions_; // A dict mapping keys to list indices
+    utils::IndexedList<T> entries_; // An ordered list of T instances. The list is ordered such that, at
+                                    // any time, the element at the front of the queue is the FIFO entry.
     // Helper method
-    const std::string& getKey(const T& entry) const { return entry.key(); }
+    FlowId getKey(const T& entry) const { return entry.key(); }
 
 public:
     // Accessors
-    std::list<T>& entries() { return entries_; }
+    utils::IndexedList<T>& entries() { return entries_; }
     size_t size() const { return entries_.size(); }
-    const std::list<T>& entries() const { return entries_; }
-    std::unordered_map<std::string, Iterator>& positions() { return positions_; }
-    const std::unordered_map<std::string, Iterator>& positions() const { return positions_; }
+    const utils::IndexedList<T>& entries() const { return entries_; }
+    utils::FlatHashMap<FlowId, Index>& positions() { return positions_; }
+    const utils::FlatHashMap<FlowId, Index>& positions() const { return positions_; }
 
-    std::unordered_map<std::string,uint64_t> Sizes2;
-    std::unordered_map<std::string,uint64_t> HisFreqs;
+    std::unordered_map<FlowId, uint64_t> Sizes2;
+    std::unordered_map<FlowId, uint64_t> HisFreqs;
 
     /**
      * Membership test.
      */
-    bool contains(const std::string& key) const {
+    bool contains(const FlowId key) const {
         return (positions_.find(key) != positions_.end());
     }
 
@@ -901,7 +1258,7 @@ public:
     }
 
 
-    void update_freqs(std::string key){
+    void update_freqs(const FlowId key){
         if(HisFreqs.find(key) == HisFreqs.end()){
             HisFreqs[key] = 1;
         }
@@ -910,21 +1267,10 @@ public:
         }
     }
 
-    void erase_elem(std::string Ky){
-        class std::list<T>::iterator It;
-        class std::list<T>::iterator Loc;
-        T entry;
-        for(It = entries_.begin(); It != entries_.end();It++){
-            std::string gkey = getKey(*It);
-            if(gkey == Ky){
-                entry = *It;
-                Loc = It;
-                break;
-            }
-        }
-
-        positions_.erase(getKey(entry));
-        entries_.erase(Loc);
+    void erase_elem(const FlowId Ky){
+        auto position_iter = positions_.find(Ky);
+        assert(position_iter != positions_.end());
+        erase(position_iter);
         HisFreqs.erase(Ky);
     }
 
@@ -932,9 +1278,10 @@ public:
      * Pop the entry at the front of the queue.
      */
     T popFront() {
-        T entry = entries_.front();
+        const Index front = entries_.front();
+        T entry = entries_[front];
         positions_.erase(getKey(entry));
-        entries_.pop_front();
+        entries_.erase(front);
         HisFreqs.erase(getKey(entry));
         return entry;
     }
@@ -943,17 +1290,16 @@ public:
      * Insert the given entry at the back of the queue.
      */
     void insertBack(const T& entry) {
-        const std::string& key = getKey(entry);
+        const FlowId key = getKey(entry);
         assert(positions_.find(key) == positions_.end());
 
-        entries_.push_back(entry);
-        positions_[key] = std::prev(entries_.end());
+        positions_.emplace(key, entries_.pushBack(entry));
     }
 };
 
 // Template specializations
-template<> const std::string&
-TQQueue<std::string>::getKey(const std::string& entry) const { return entry; }
+template<> FlowId
+TQQueue<FlowId>::getKey(const FlowId& entry) const { return entry; }
 
 
 
@@ -962,17 +1308,17 @@ TQQueue<std::string>::getKey(const std::string& entry) const { return entry; }
  */
 template<class T> class MinHeapEntry {
 private:
-    std::string key_; // Cache tag corresponding to this min-heap entry
+    FlowId key_; // Cache tag corresponding to this min-heap entry
     size_t last_ref_time_; // Time (in clock cycles) of last reference
     size_t insertion_time_; // Time (in clock cycles) of insertion
     T primary_metric_; // The primary priority metric
 
 public:
-    MinHeapEntry(const std::string& key, const T& metric, const size_t lr_time,
+    MinHeapEntry(const FlowId key, const T& metric, const size_t lr_time,
                  const size_t in_time) : key_(key), last_ref_time_(lr_time),
                  insertion_time_(in_time), primary_metric_(metric) {}
     // Accessors
-    const std::string& key() const { return key_; }
+    FlowId key() const { return key_; }
     T getPrimaryMetric() const { return primary_metric_; }
     size_t getLastRefTime() const { return last_ref_time_; }
     size_t getInsertionTime() const { return insertion_time_; }
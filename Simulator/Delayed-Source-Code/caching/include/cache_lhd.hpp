@@ -0,0 +1,507 @@
+#ifndef cache_lhd_h
+#define cache_lhd_h
+
+// STD headers
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Platform headers
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define LHD_HAS_AVX2_PATH 1
+#endif
+
+namespace caching {
+
+/**
+ * Implements the per-class age tables of the LHD-based policies: the
+ * (EWMA-decayed) hit and eviction counts observed at every age, from
+ * which the hit densities are modeled at every reconfiguration.
+ *
+ * The tables (including the hit-density tables they model) are laid
+ * out age-major (i.e., element [age][class]), so that the
+ * reconfiguration sweeps process every class side by side.
+ * Each class occupies its own SIMD lane and undergoes exactly the same
+ * sequence of floating-point operations as in a per-class scalar loop,
+ * so the AVX2 and scalar paths produce bit-identical tables.
+ */
+class LHDClassTables {
+private:
+    const size_t kNumClasses; // Number of object classes
+    const size_t kMaxAge; // Number of (coarsened) ages per class
+    bool is_using_avx2_ = false; // Whether to use the AVX2 path
+
+    std::vector<double> hits_; // Hit counts, by [age][class]
+    std::vector<double> evictions_; // Eviction counts, by [age][class]
+    std::vector<double> total_hits_; // Total hit counts, by class
+    std::vector<double> total_evictions_; // Total eviction counts, by class
+
+    /**
+     * Internal helper methods. Apply the EWMA decay and recompute
+     * the totals for classes [first_class, kNumClasses).
+     */
+    void decayScalar(const double factor, const size_t first_class) {
+        for (size_t c = first_class; c < kNumClasses; c++) {
+            total_hits_[c] = 0;
+            total_evictions_[c] = 0;
+        }
+        for (size_t age = 0; age < kMaxAge; age++) {
+            for (size_t c = first_class; c < kNumClasses; c++) {
+                const size_t idx = getIdx(c, age);
+                hits_[idx] *= factor;
+                evictions_[idx] *= factor;
+
+                total_hits_[c] += hits_[idx];
+                total_evictions_[c] += evictions_[idx];
+            }
+        }
+    }
+#if defined(LHD_HAS_AVX2_PATH)
+    __attribute__((target("avx2")))
+    size_t decayAVX2(const double factor) {
+        const size_t num_vector_classes = (kNumClasses & ~size_t(3));
+        const __m256d factors = _mm256_set1_pd(factor);
+        for (size_t c = 0; c < num_vector_classes; c += 4) {
+            _mm256_storeu_pd(&total_hits_[c], _mm256_setzero_pd());
+            _mm256_storeu_pd(&total_evictions_[c], _mm256_setzero_pd());
+        }
+        for (size_t age = 0; age < kMaxAge; age++) {
+            for (size_t c = 0; c < num_vector_classes; c += 4) {
+                const size_t idx = getIdx(c, age);
+                const __m256d hits = _mm256_mul_pd(_mm256_loadu_pd(&hits_[idx]), factors);
+                const __m256d evictions = _mm256_mul_pd(_mm256_loadu_pd(&evictions_[idx]), factors);
+                _mm256_storeu_pd(&hits_[idx], hits);
+                _mm256_storeu_pd(&evictions_[idx], evictions);
+
+                _mm256_storeu_pd(&total_hits_[c], _mm256_add_pd(
+                    _mm256_loadu_pd(&total_hits_[c]), hits));
+                _mm256_storeu_pd(&total_evictions_[c], _mm256_add_pd(
+                    _mm256_loadu_pd(&total_evictions_[c]), evictions));
+            }
+        }
+        return num_vector_classes;
+    }
+#endif
+
+    /**
+     * Internal helper methods. Model the hit densities for classes
+     * [first_class, kNumClasses). We use a small trick here to compute
+     * expectation in O(N) by accumulating all values at later ages.
+     */
+    void modelHitDensityScalar(double* hit_densities, const size_t first_class) const {
+        const size_t num_classes = (kNumClasses - first_class);
+        std::vector<double> total_hits(num_classes), total_events(num_classes);
+        std::vector<double> lifetime_unconditioned(num_classes);
+        for (size_t c = 0; c < num_classes; c++) {
+            const size_t idx = getIdx(first_class + c, kMaxAge - 1);
+            total_events[c] = hits_[idx] + evictions_[idx];
+            total_hits[c] = hits_[idx];
+            lifetime_unconditioned[c] = total_events[c];
+        }
+        for (size_t a = kMaxAge - 2; a < kMaxAge; a--) {
+            for (size_t c = 0; c < num_classes; c++) {
+                const size_t idx = getIdx(first_class + c, a);
+                total_hits[c] += hits_[idx];
+                total_events[c] += hits_[idx] + evictions_[idx];
+
+                lifetime_unconditioned[c] += total_events[c];
+                if (total_events[c] > 1e-5) {
+                    hit_densities[idx] = total_hits[c] / lifetime_unconditioned[c];
+                } else {
+                    hit_densities[idx] = 0.;
+                }
+            }
+        }
+    }
+#if defined(LHD_HAS_AVX2_PATH)
+    __attribute__((target("avx2")))
+    size_t modelHitDensityAVX2(double* hit_densities) const {
+        const size_t num_vector_classes = (kNumClasses & ~size_t(3));
+        const size_t num_vectors = (num_vector_classes / 4);
+        std::vector<double> state(num_vector_classes * 3); // Per-class running sums
+        double* total_hits = state.data();
+        double* total_events = total_hits + num_vector_classes;
+        double* lifetime_unconditioned = total_events + num_vector_classes;
+
+        for (size_t c = 0; c < num_vector_classes; c++) {
+            const size_t idx = getIdx(c, kMaxAge - 1);
+            total_events[c] = hits_[idx] + evictions_[idx];
+            total_hits[c] = hits_[idx];
+            lifetime_unconditioned[c] = total_events[c];
+        }
+        const __m256d threshold = _mm256_set1_pd(1e-5);
+        for (size_t a = kMaxAge - 2; a < kMaxAge; a--) {
+            for (size_t v = 0; v < num_vectors; v++) {
+                const size_t c = (v * 4);
+                const size_t idx = getIdx(c, a);
+                const __m256d hits = _mm256_loadu_pd(&hits_[idx]);
+                const __m256d evictions = _mm256_loadu_pd(&evictions_[idx]);
+
+                const __m256d hits_sum = _mm256_add_pd(_mm256_loadu_pd(&total_hits[c]), hits);
+                const __m256d events_sum = _mm256_add_pd(_mm256_loadu_pd(&total_events[c]),
+                                                         _mm256_add_pd(hits, evictions));
+                const __m256d lifetime = _mm256_add_pd(
+                    _mm256_loadu_pd(&lifetime_unconditioned[c]), events_sum);
+
+                // Lanes with too few events get a hit density of (+)0
+                const __m256d mask = _mm256_cmp_pd(events_sum, threshold, _CMP_GT_OQ);
+                _mm256_storeu_pd(&hit_densities[idx], _mm256_and_pd(
+                    mask, _mm256_div_pd(hits_sum, lifetime)));
+
+                _mm256_storeu_pd(&total_hits[c], hits_sum);
+                _mm256_storeu_pd(&total_events[c], events_sum);
+                _mm256_storeu_pd(&lifetime_unconditioned[c], lifetime);
+            }
+        }
+        return num_vector_classes;
+    }
+#endif
+
+public:
+    LHDClassTables(const size_t num_classes, const size_t max_age) :
+        kNumClasses(num_classes), kMaxAge(max_age),
+        hits_(num_classes * max_age, 0), evictions_(num_classes * max_age, 0),
+        total_hits_(num_classes, 0), total_evictions_(num_classes, 0) {
+#if defined(LHD_HAS_AVX2_PATH)
+        is_using_avx2_ = __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    // Accessors
+    size_t getNumClasses() const { return kNumClasses; }
+    size_t getMaxAge() const { return kMaxAge; }
+    size_t getTableSize() const { return kNumClasses * kMaxAge; }
+    bool isUsingAVX2() const { return is_using_avx2_; }
+    double getTotalHits(const size_t class_id) const { return total_hits_.at(class_id); }
+    double getTotalEvictions(const size_t class_id) const { return total_evictions_.at(class_id); }
+
+    double& hits(const size_t class_id, const size_t age) {
+        return hits_[getIdx(class_id, age)];
+    }
+    double& evictions(const size_t class_id, const size_t age) {
+        return evictions_[getIdx(class_id, age)];
+    }
+
+    /**
+     * Returns the table index for the given class and age.
+     */
+    size_t getIdx(const size_t class_id, const size_t age) const {
+        assert(class_id < kNumClasses && age < kMaxAge);
+        return (age * kNumClasses) + class_id;
+    }
+
+    /**
+     * Selects the scalar path, even if AVX2 is available (for testing).
+     */
+    void disableAVX2() { is_using_avx2_ = false; }
+
+    /**
+     * Applies the EWMA decay to every class' hit and eviction counts,
+     * and recomputes the corresponding totals.
+     */
+    void decay(const double factor) {
+        size_t first_scalar_class = 0;
+#if defined(LHD_HAS_AVX2_PATH)
+        if (is_using_avx2_) { first_scalar_class = decayAVX2(factor); }
+#endif
+        if (first_scalar_class < kNumClasses) {
+            decayScalar(factor, first_scalar_class);
+        }
+    }
+
+    /**
+     * Models every class' hit densities from its hit and eviction counts,
+     * writing them to the given (age-major) table. The hit density at the
+     * maximum age is left untouched.
+     */
+    void modelHitDensity(std::vector<double>& hit_densities) const {
+        assert(hit_densities.size() == getTableSize());
+        size_t first_scalar_class = 0;
+#if defined(LHD_HAS_AVX2_PATH)
+        if (is_using_avx2_) {
+            first_scalar_class = modelHitDensityAVX2(hit_densities.data());
+        }
+#endif
+        if (first_scalar_class < kNumClasses) {
+            modelHitDensityScalar(hit_densities.data(), first_scalar_class);
+        }
+    }
+
+    /**
+     * Compresses (delta > 0) or stretches (delta < 0) every class'
+     * distributions by 2^|delta|, to approximate a new age coarsening.
+     */
+    void rescaleAges(const int32_t delta) {
+        if (delta < 0) {
+            // Stretch
+            for (size_t c = 0; c < kNumClasses; c++) {
+                for (size_t a = kMaxAge >> (-delta); a < kMaxAge - 1; a++) {
+                    hits(c, kMaxAge - 1) += hits(c, a);
+                    evictions(c, kMaxAge - 1) += evictions(c, a);
+                }
+                for (size_t a = kMaxAge - 2; a < kMaxAge; a--) {
+                    hits(c, a) = hits(c, a >> (-delta)) / (1 << (-delta));
+                    evictions(c, a) = evictions(c, a >> (-delta)) / (1 << (-delta));
+                }
+            }
+        } else if (delta > 0) {
+            // Compress
+            for (size_t c = 0; c < kNumClasses; c++) {
+                for (size_t a = 0; a < kMaxAge >> delta; a++) {
+                    hits(c, a) = hits(c, a << delta);
+                    evictions(c, a) = evictions(c, a << delta);
+                    for (int i = 1; i < (1 << delta); i++) {
+                        hits(c, a) += hits(c, (a << delta) + i);
+                        evictions(c, a) += evictions(c, (a << delta) + i);
+                    }
+                }
+                for (size_t a = (kMaxAge >> delta); a < kMaxAge - 1; a++) {
+                    hits(c, a) = 0;
+                    evictions(c, a) = 0;
+                }
+            }
+        }
+    }
+
+    /**
+     * Adds the hit and eviction counts of another table to this one.
+     */
+    void accumulate(const LHDClassTables& other) {
+        assert(other.getTableSize() == getTableSize());
+        for (size_t idx = 0; idx < getTableSize(); idx++) {
+            hits_[idx] += other.hits_[idx];
+            evictions_[idx] += other.evictions_[idx];
+        }
+    }
+
+    /**
+     * Resets every hit and eviction count to zero.
+     */
+    void clear() {
+        std::fill(hits_.begin(), hits_.end(), 0);
+        std::fill(evictions_.begin(), evictions_.end(), 0);
+    }
+
+    /**
+     * Swaps the hit and eviction counts with another table in O(1).
+     */
+    void swap(LHDClassTables& other) {
+        assert(other.getTableSize() == getTableSize());
+        hits_.swap(other.hits_);
+        evictions_.swap(other.evictions_);
+        total_hits_.swap(other.total_hits_);
+        total_evictions_.swap(other.total_evictions_);
+    }
+};
+
+/**
+ * Implements the LHD hit-density model.
+ *
+ * The request path records hits and evictions, and looks up hit
+ * densities; every reconfiguration (EWMA decay, age rescaling, and
+ * density modeling) runs on a background worker thread. On each
+ * reconfiguration, the request path hands the events it recorded
+ * since the last one to the worker (by swapping them with a cleared
+ * table, in O(1)), and the worker folds them into its decayed tables
+ * and models a new hit-density table. The hit densities are double
+ * buffered: the worker writes to the table not in use, and publishes
+ * it with an atomic pointer swap.
+ *
+ * To keep simulations reproducible, the request path adopts the new
+ * table exactly kAdoptionLag accesses after starting a reconfiguration
+ * (recordAccess()), rather than whenever the worker happens to finish.
+ * Modeling takes orders of magnitude less time than serving that many
+ * accesses, so in practice the request path never waits for it. The
+ * worker is started on the first reconfiguration. With background
+ * reconfiguration disabled, every reconfiguration runs inline instead,
+ * exactly as in the original LHD implementation.
+ */
+class LHDHitDensityModel {
+private:
+    static constexpr size_t kAdoptionLag = (1 << 14);
+
+    const double kEWMADecay; // EWMA decay applied at every reconfiguration
+    bool is_background_ = true; // Whether to reconfigure on a worker thread
+
+    // Request path
+    LHDClassTables events_; // Events recorded since the last reconfiguration
+                            // (or, if reconfiguring inline, the model itself)
+    std::vector<double> hit_densities_[2]; // Double-buffered hit-density tables
+    const std::vector<double>* current_hit_densities_; // Table in use
+    std::atomic<const std::vector<double>*> published_hit_densities_{nullptr};
+    size_t accesses_until_adoption_ = 0; // Countdown to adopting a pending table
+
+    // Worker thread
+    LHDClassTables model_; // Decayed hit and eviction counts
+    LHDClassTables handoff_; // Events handed off to the worker
+    std::vector<double>* target_hit_densities_ = nullptr; // Table to model into
+    int32_t coarsening_delta_ = 0; // Age rescaling for the pending reconfiguration
+    bool has_job_ = false; // Whether a reconfiguration is pending
+    bool is_stopping_ = false; // Whether the worker should exit
+    std::mutex mutex_;
+    std::condition_variable job_cv_; // Signals a new job (or exit)
+    std::condition_variable done_cv_; // Signals a published table
+    std::thread worker_;
+
+    /**
+     * Internal helper method. Runs a full reconfiguration of the given
+     * tables, modeling the hit densities into the given table.
+     */
+    void reconfigure(LHDClassTables& tables, const int32_t coarsening_delta,
+                     std::vector<double>& hit_densities) const {
+        tables.decay(kEWMADecay);
+        tables.rescaleAges(coarsening_delta);
+        tables.modelHitDensity(hit_densities);
+    }
+
+    /**
+     * Internal helper method. The worker thread's main loop.
+     */
+    void runWorker() {
+        while (true) {
+            std::vector<double>* target = nullptr;
+            int32_t coarsening_delta = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                job_cv_.wait(lock, [this] { return has_job_ || is_stopping_; });
+                if (is_stopping_) { return; }
+                target = target_hit_densities_;
+                coarsening_delta = coarsening_delta_;
+            }
+            // Fold in the handed-off events, and clear them
+            // for the next handoff before publishing.
+            model_.accumulate(handoff_);
+            handoff_.clear();
+            reconfigure(model_, coarsening_delta, *target);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                has_job_ = false;
+                published_hit_densities_.store(target, std::memory_order_release);
+            }
+            done_cv_.notify_one();
+        }
+    }
+
+public:
+    LHDHitDensityModel(const size_t num_classes, const size_t max_age,
+                       const double ewma_decay) : kEWMADecay(ewma_decay),
+                       events_(num_classes, max_age), model_(num_classes, max_age),
+                       handoff_(num_classes, max_age) {
+        for (auto& hit_densities : hit_densities_) {
+            hit_densities.resize(events_.getTableSize(), 0);
+        }
+        current_hit_densities_ = &hit_densities_[0];
+    }
+    ~LHDHitDensityModel() {
+        if (worker_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                is_stopping_ = true;
+            }
+            job_cv_.notify_one();
+            worker_.join();
+        }
+    }
+    LHDHitDensityModel(const LHDHitDensityModel&) = delete;
+    LHDHitDensityModel& operator=(const LHDHitDensityModel&) = delete;
+
+    // Accessors
+    bool isBackground() const { return is_background_; }
+    bool isPending() const { return (accesses_until_adoption_ > 0); }
+
+    /**
+     * Selects background (default) or inline reconfiguration
+     * (for use before the first reconfiguration only).
+     */
+    void setBackground(const bool is_background) {
+        assert(!worker_.joinable());
+        is_background_ = is_background;
+    }
+
+    /**
+     * Request path. Record a hit (or eviction) at the given class and age.
+     */
+    void recordHit(const size_t class_id, const size_t age) {
+        events_.hits(class_id, age) += 1;
+    }
+    void recordEviction(const size_t class_id, const size_t age) {
+        events_.evictions(class_id, age) += 1;
+    }
+
+    /**
+     * Request path. Returns the hit density at the given class and age.
+     */
+    double getHitDensity(const size_t class_id, const size_t age) const {
+        return (*current_hit_densities_)[events_.getIdx(class_id, age)];
+    }
+
+    /**
+     * Sets the initial hit density at the given class and age
+     * (for use before the first reconfiguration only).
+     */
+    void setInitialHitDensity(const size_t class_id, const size_t age,
+                              const double density) {
+        for (auto& hit_densities : hit_densities_) {
+            hit_densities[events_.getIdx(class_id, age)] = density;
+        }
+    }
+
+    /**
+     * Request path. Starts a reconfiguration, which rescales the age
+     * distributions by 2^coarsening_delta (see rescaleAges()). If running
+     * inline, the new hit densities are in use when this returns.
+     */
+    void reconfigure(const int32_t coarsening_delta) {
+        if (!is_background_) {
+            reconfigure(events_, coarsening_delta, hit_densities_[0]);
+            return;
+        }
+        assert(!isPending());
+        if (!worker_.joinable()) {
+            worker_ = std::thread(&LHDHitDensityModel::runWorker, this);
+        }
+        std::vector<double>* target = &hit_densities_[
+            (current_hit_densities_ == &hit_densities_[0]) ? 1 : 0];
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // The worker cleared the handoff table before publishing
+            // the previous table, and hence is not using it anymore.
+            events_.swap(handoff_);
+            target_hit_densities_ = target;
+            coarsening_delta_ = coarsening_delta;
+            has_job_ = true;
+        }
+        job_cv_.notify_one();
+        accesses_until_adoption_ = kAdoptionLag;
+    }
+
+    /**
+     * Request path. Records an access, adopting the pending
+     * hit-density table once kAdoptionLag accesses have elapsed.
+     */
+    void recordAccess() {
+        if (accesses_until_adoption_ == 0 || --accesses_until_adoption_ > 0) { return; }
+
+        const std::vector<double>* published = published_hit_densities_.exchange(
+            nullptr, std::memory_order_acquire);
+        if (published == nullptr) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_cv_.wait(lock, [this] { return !has_job_; });
+            published = published_hit_densities_.exchange(
+                nullptr, std::memory_order_acquire);
+        }
+        assert(published != nullptr);
+        current_hit_densities_ = published;
+    }
+};
+
+} // namespace caching
+
+#endif // cache_lhd_h
@@ -31,12 +31,12 @@ public:
     TwoQCacheSet(const size_t num_entries, const size_t misslat) : BaseCacheSet(num_entries,misslat) {}
     virtual ~TwoQCacheSet() {}
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
+    std::unordered_map<FlowId, uint64_t> Sizes1;
     uint64_t UsedSpace_Fifo = 0;
     uint64_t UsedSpace_Lru = 0;
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
+    update_freqs(const FlowId key, uint64_t size){
        //SUPPRESS_UNUSED_WARNING(key);
        if(Sizes1.find(key) == Sizes1.end()){
            Sizes1[key] = size;
@@ -53,7 +53,7 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    write(const FlowId key, const utils::Packet& packet) override {
         SUPPRESS_UNUSED_WARNING(packet);
         CacheEntry written_entry;
         CacheEntry evicted_entry;
@@ -64,25 +64,23 @@ public:
         if (position_iter_0 != Lru.positions().end()) {
             incache = 0;
             // LRU Hit
-            written_entry = *(position_iter_0->second);
+            written_entry = Lru.entries()[position_iter_0->second];
 
             // Sanity checks
             assert(contains(key));
             assert(written_entry.isValid());
             assert(written_entry.key() == key);
             // If the read was successful, the corresponding entry is
-            // the MRU element in the cache. Remove it from the queue.
-            Lru.erase(position_iter_0);
-
+            // the MRU element in the cache. Move it to the back.
             //更新LRU的list
-            Lru.insertBack(written_entry);
+            Lru.moveToBack(position_iter_0);
         }
 
         auto position_iter = Fifo.positions().find(key);
         if (position_iter != Fifo.positions().end()) {
             incache = 1;
             // FIFO Hit
-            written_entry = *(position_iter->second);
+            written_entry = Fifo.entries()[position_iter->second];
 
             // Sanity checks
             assert(contains(key));
@@ -138,13 +136,12 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        const utils::Packet& packet = queue.back();
-        return write(packet.getFlowId(), packet);
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId(), read.getPacket());
     }
 };
 
@@ -171,6 +168,11 @@ public:
      * Returns the canonical cache name.
      */
     virtual std::string name() const override { return "TwoQCache"; }
+
+    /**
+     * The cache sets share no policy state.
+     */
+    virtual bool hasIndependentSets() const override { return true; }
 };
 
 // Run default benchmarks
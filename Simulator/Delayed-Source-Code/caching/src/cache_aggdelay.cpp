@@ -1,101 +1,274 @@
 // STD headers
 #include <assert.h>
 #include <limits>
-#include <list>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 // Custom headers
 #include "cache_base.hpp"
-#include "cache_belady.hpp"
 #include "cache_common.hpp"
+#include "indexed_heap.hpp"
+#include "trace_reader.hpp"
 #include "utils.hpp"
 
 using namespace caching;
 namespace bopt = boost::program_options;
 
 /**
- * Implements a single-tiered BeladyAggregateDelay cache.
+ * Implements the offline (trace-analysis) stage of the
+ * BeladyAggregateDelay policy.
+ *
+ * For every trace index, precomputes the index of the next request to
+ * the same flow, and the aggregate delay incurred if the flow is not
+ * cached when that request arrives: the sum of (miss latency - offset)
+ * over every request to the flow within one miss latency of it. Each
+ * flow's current occurrence (the first request at or after the current
+ * clock) is tracked in a flat array, and is only ever moved forward.
  */
-class BeladyAggregateDelayCache : public BaseCache {
+class AggregateDelayOracle {
 private:
-    utils::TraceAnalyzer* analyzer_; // A TraceAnalyzer instance
-    typedef std::list<size_t>::const_iterator IdxIterator;
-    std::unordered_map<std::string, IdxIterator>
-    flow_ids_to_current_iters_; // Dict mapping flow IDs to their current
-                                // positions in corresponding idxs lists.
+    static constexpr size_t kNoOccurrence = std::numeric_limits<size_t>::max();
+
+    std::vector<size_t> next_occurrences_; // Next request idx to the same flow, by trace idx
+    std::vector<double> window_costs_; // Aggregate-delay cost, by trace idx
+    std::vector<size_t> current_occurrences_; // Current occurrence, by FlowId
+
+public:
+    AggregateDelayOracle(const std::string& trace_fp, const size_t miss_latency,
+                         utils::FlowIdTable& flow_ids) {
+        utils::TraceReader reader(trace_fp);
+        utils::TraceRecord record;
+
+        // Record the flow requested at every trace idx (empty
+        // packets still take up a cycle, and hence an idx).
+        std::vector<FlowId> trace;
+        while (reader.next(record)) {
+            trace.push_back(record.flow_id.empty() ? utils::kInvalidFlowId :
+                            flow_ids.intern(record.flow_id));
+        }
+        // Link every request to the next request to the same flow
+        next_occurrences_.assign(trace.size(), kNoOccurrence);
+        current_occurrences_.assign(flow_ids.size(), kNoOccurrence);
+        for (size_t idx = trace.size(); idx-- > 0;) {
+            if (trace[idx] == utils::kInvalidFlowId) { continue; }
+            next_occurrences_[idx] = current_occurrences_[trace[idx]];
+            current_occurrences_[trace[idx]] = idx;
+        }
+        // Compute the windowed costs, sliding a window of one miss latency
+        // over each flow's requests. For a window starting at idx, holding
+        // count requests whose indices sum to sum, the cost is given by:
+        // count * (miss_latency + idx) - sum.
+        std::vector<size_t> window_ends(current_occurrences_);
+        std::vector<uint64_t> window_counts(flow_ids.size(), 0);
+        std::vector<uint64_t> window_sums(flow_ids.size(), 0);
+
+        window_costs_.assign(trace.size(), 0);
+        for (size_t idx = 0; idx < trace.size(); idx++) {
+            const FlowId flow_id = trace[idx];
+            if (flow_id == utils::kInvalidFlowId) { continue; }
+
+            size_t& end = window_ends[flow_id];
+            uint64_t& count = window_counts[flow_id];
+            uint64_t& sum = window_sums[flow_id];
+            while (end != kNoOccurrence && (end - idx) < miss_latency) {
+                count++; sum += end;
+                end = next_occurrences_[end];
+            }
+            window_costs_[idx] = static_cast<double>(
+                (count * (miss_latency + idx)) - sum);
+
+            // Slide the window past this request
+            count--; sum -= idx;
+        }
+    }
+
+    /**
+     * Returns the given flow's current occurrence.
+     */
+    size_t getOccurrence(const FlowId flow_id) const {
+        return current_occurrences_.at(flow_id);
+    }
+
+    /**
+     * Returns the cost of not caching the given flow at its current occurrence.
+     */
+    double getCost(const FlowId flow_id) const {
+        const size_t occurrence = getOccurrence(flow_id);
+        return (occurrence == kNoOccurrence) ? 0 : window_costs_[occurrence];
+    }
+
+    /**
+     * Forwards the given flow's current occurrence until it corresponds
+     * to a request that arrives at or after clk (or strictly after clk,
+     * if exclusive is set). Returns whether the occurrence changed.
+     */
+    bool advance(const FlowId flow_id, const size_t clk, const bool exclusive) {
+        size_t& occurrence = current_occurrences_.at(flow_id);
+        const size_t initial_occurrence = occurrence;
+        while (occurrence != kNoOccurrence &&
+               (occurrence < clk || (exclusive && occurrence == clk))) {
+            occurrence = next_occurrences_[occurrence];
+        }
+        return (occurrence != initial_occurrence);
+    }
+};
+
+/**
+ * Represents a single set (row) in a BeladyAggregateDelay cache.
+ *
+ * Cached flows are kept in an indexed min-heap keyed by their current
+ * aggregate-delay cost. Costs only change when a flow's current
+ * occurrence moves forward, which happens once the flow's request has
+ * been served; hence, only the flow requested most recently in this
+ * set can have a stale priority at any given time.
+ */
+class AggregateDelayCacheSet : public BaseCacheSet {
+private:
+    // Smallest cost first; among equal costs, furthest occurrence first
+    typedef std::pair<double, size_t> Priority;
+    struct CheapestFirst {
+        bool operator()(const Priority& a, const Priority& b) const {
+            return (a.first < b.first) || (a.first == b.first && a.second > b.second);
+        }
+    };
+    const BaseCache& cache_; // Reference to the cache (for the clock)
+    AggregateDelayOracle& oracle_; // Reference to the shared oracle
+    utils::IndexedHeap<Priority, CheapestFirst> costs_; // Cached flows, by cost
+    std::vector<uint64_t> sizes_; // Flow sizes, by FlowId
+    uint64_t used_space_ = 0; // Total size of the cached flows
+    FlowId last_requested_ = utils::kInvalidFlowId; // Most recently requested flow
+
+    /**
+     * Internal helper method. Returns the priority of the given flow.
+     */
+    Priority getPriority(const FlowId key) const {
+        return Priority(oracle_.getCost(key), oracle_.getOccurrence(key));
+    }
+
+    /**
+     * Internal helper method. Forwards the given flow's current
+     * occurrence past clk, and updates its priority if required.
+     */
+    void advance(const FlowId key, const bool exclusive) {
+        if (oracle_.advance(key, cache_.clk(), exclusive) && costs_.contains(key)) {
+            costs_.update(key, getPriority(key));
+        }
+    }
+
     /**
-     * Given the current state of the and the contending flow,
-     * returns the flow ID corresponding to the flow to evict.
+     * Internal helper method. Returns the flow ID corresponding to the
+     * flow to evict, or the contender itself if it should be rejected.
      */
-    std::string getFlowIdToEvict(const std::unordered_map<std::string, CacheEntry>&
-                                 candidates, const std::string& contender, bool evicted=0) {
+    FlowId getFlowIdToEvict(const FlowId contender, const bool evicted) {
+        if (last_requested_ != utils::kInvalidFlowId) {
+            advance(last_requested_, false);
+        }
         double min_candidate_cost = std::numeric_limits<double>::max();
-        std::string flow_id_to_evict;
-        if(evicted == 1){
-            SUPPRESS_UNUSED_WARNING(contender);
+        FlowId flow_id_to_evict = utils::kInvalidFlowId;
+        if (!costs_.empty()) {
+            min_candidate_cost = costs_.top().first.first;
+            flow_id_to_evict = costs_.top().second;
         }
-        for (const auto& pair : candidates) {
-            const std::string& candidate = pair.first;
-
-            // First, forward the flow's occurence idx until it corresponds to
-            // a packet arrival that is GEQ clk. This value indicates when the
-            // very next packet for this flow arrives.
-            const auto& indices = analyzer_->getFlowData(candidate).indices();
-            IdxIterator iter = flow_ids_to_current_iters_.at(candidate);
-            while (iter != indices.end() && (*iter < clk())) { iter++; }
-            flow_ids_to_current_iters_[candidate] = iter;
-
-            size_t next_occurence = (iter != indices.end()) ?
-                *iter : std::numeric_limits<size_t>::max();
-
-            double current_cost = 0;
-            while (iter != indices.end() && (*iter - next_occurence) < kCacheMissLatency) {
-                current_cost += kCacheMissLatency - (*iter - next_occurence);
-                iter++;
+        // If the cost of rejecting the contender is smaller than evicting
+        // any of the candidate flows, do not admit it into the cache.
+        if (!evicted) {
+            oracle_.advance(contender, cache_.clk(), true);
+            if (oracle_.getCost(contender) < min_candidate_cost) {
+                flow_id_to_evict = contender;
             }
+        }
+        return flow_id_to_evict;
+    }
 
-            // Normalize the cost by distance
-            if (current_cost < -1000000) { current_cost /= (next_occurence - clk() + 1); }
+public:
+    AggregateDelayCacheSet(const size_t num_entries, const size_t misslat,
+                           const BaseCache& cache, AggregateDelayOracle& oracle) :
+                           BaseCacheSet(num_entries, misslat), cache_(cache),
+                           oracle_(oracle) {}
+    virtual ~AggregateDelayCacheSet() {}
 
-            // If this flow has finished, or evicting it
-            // incurs the smallest delay-cost, evict it.
-            if (current_cost < min_candidate_cost) {
-                min_candidate_cost = current_cost;
-                flow_id_to_evict = candidate;
-            }
+    virtual int
+    update_freqs(const FlowId key, uint64_t size) override {
+        if (key >= sizes_.size()) { sizes_.resize(key + 1, 0); }
+        if (sizes_[key] == 0) { sizes_[key] = size; }
+
+        // The previously-requested flow's request has been served
+        if (last_requested_ != utils::kInvalidFlowId) {
+            advance(last_requested_, false);
         }
-        // Forward the contending flow's occurence idx until it corresponds
-        // to a packet arrival that is GT clk.
-        if(evicted == 0){
-            const auto& indices = analyzer_->getFlowData(contender).indices();
-            IdxIterator iter = flow_ids_to_current_iters_.at(contender);
-            while (iter != indices.end() && (*iter <= clk())) { iter++; }
-            flow_ids_to_current_iters_[contender] = iter;
-
-            size_t next_contender_occurence = (iter != indices.end()) ?
-                *iter : std::numeric_limits<size_t>::max();
-
-            double contender_cost = 0;
-            while (iter != indices.end() &&
-                   (*iter - next_contender_occurence) < kCacheMissLatency) {
-                contender_cost += kCacheMissLatency - (*iter - next_contender_occurence);
-                iter++;
-            }
+        last_requested_ = key;
+        return 0;
+    }
 
-            // Normalize the cost by distance
-            if (contender_cost < -10000000) { contender_cost /= (next_contender_occurence - clk() + 1); }
+    /**
+     * Simulates a cache write.
+     *
+     * @param key The key corresponding to this write request.
+     * @param packet The packet corresponding to this write request.
+     * @return The written CacheEntry instance.
+     */
+    virtual CacheEntry
+    write(const FlowId key, const utils::Packet& packet) override {
+        SUPPRESS_UNUSED_WARNING(packet);
+        CacheEntry written_entry;
+        written_entry.update(key);
+        written_entry.toggleValid();
 
-            // If the cost of rejecting the contender is smaller than evicting
-            // any of the candidate flows, do not admit it into the cache.
-            if (contender_cost < min_candidate_cost) {
-                flow_id_to_evict = contender;
+        // If a corresponding entry exists, there is nothing to do
+        if (contains(key)) { return written_entry; }
+
+        // If required, evict existing entries. Note that a rejected
+        // contender still evicts entries until there is free space.
+        bool evicted = false;
+        while (used_space_ >= getNumEntries()) {
+            const FlowId evicted_key = getFlowIdToEvict(key, evicted);
+            assert(evicted_key != utils::kInvalidFlowId);
+
+            // Reject the contender
+            if (evicted_key == key) {
+                evicted = true;
+                written_entry.toggleValid();
+            }
+            // Evict an existing cache entry
+            else {
+                costs_.erase(evicted_key);
+                occupied_entries_set_.erase(evicted_key);
+                used_space_ -= sizes_[evicted_key];
             }
         }
+        // If required, update the cache
+        if (written_entry.isValid()) {
+            costs_.push(key, getPriority(key));
+            occupied_entries_set_.insert(key);
+            used_space_ += sizes_[key];
+        }
+        // Sanity checks
+        assert(occupied_entries_set_.size() == costs_.size());
+        return written_entry;
+    }
 
-        return flow_id_to_evict;
+    /**
+     * Simulates a sequence of cache writes for a particular flow's packet queue.
+     * Invoking this method should be functionally equivalent to invoking write()
+     * on every queued packet; this simply presents an optimization opportunity
+     * for policies which do not distinguish between single/multiple writes.
+     *
+     * @param read The completed read, holding the queued write requests.
+     * @return The written CacheEntry instance.
+     */
+    virtual CacheEntry
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId(), read.getPacket());
     }
+};
+
+/**
+ * Implements a single-tiered BeladyAggregateDelay cache.
+ */
+class BeladyAggregateDelayCache : public BaseCache {
+private:
+    AggregateDelayOracle* oracle_; // Precomputed next occurrences and costs
 
 public:
     BeladyAggregateDelayCache(const size_t miss_latency, const size_t cache_set_associativity,
@@ -115,22 +288,16 @@ public:
         bopt::notify(variables);
         std::string trace_fp = variables.at("trace").as<std::string>();
 
-        // Initialize the TraceAnalyzer and the cache sets
-        analyzer_ = new utils::TraceAnalyzer(trace_fp);
+        // Initialize the oracle and the cache sets
+        oracle_ = new AggregateDelayOracle(trace_fp, miss_latency, flow_ids_);
         for (size_t idx = 0; idx < kMaxNumCacheSets; idx++) {
-            cache_sets_.push_back(new BeladyCacheSet<BeladyAggregateDelayCache>(
-                kCacheSetAssociativity, miss_latency, *this));
-        }
-        // Prime the iterators map
-        const auto& flowIdsToDataMap = analyzer_->getFlowIdsToDataMap();
-        for (const auto& pair : flowIdsToDataMap) {
-            flow_ids_to_current_iters_[pair.first] = (
-                pair.second.indices().begin());
+            cache_sets_.push_back(new AggregateDelayCacheSet(
+                kCacheSetAssociativity, miss_latency, *this, *oracle_));
         }
     }
     virtual ~BeladyAggregateDelayCache() {
-        delete(analyzer_);
-        analyzer_ = nullptr;
+        delete(oracle_);
+        oracle_ = nullptr;
     }
 
     /**
@@ -138,8 +305,10 @@ public:
      */
     virtual std::string name() const override { return "ADCache"; }
 
-    // Allow access to getFlowIdToEvict()
-    friend class BeladyCacheSet<BeladyAggregateDelayCache>;
+    /**
+     * The cache sets only share the (per-flow) oracle.
+     */
+    virtual bool hasIndependentSets() const override { return true; }
 };
 
 // Run default benchmarks
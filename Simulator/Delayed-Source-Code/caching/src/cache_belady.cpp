@@ -23,21 +23,18 @@ public:
     LRUCacheSet(const size_t num_entries, const size_t misslat) : BaseCacheSet(num_entries,misslat) {}
     virtual ~LRUCacheSet() {}
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
+    std::unordered_map<FlowId, uint64_t> Sizes1;
     uint64_t UsedSpace = 0;
-    std::vector<std::string> Trace;
     uint64_t TimeProc = 0;
 
     virtual void
-    inittrace(std::vector<std::string> Ids){
-        Trace = Ids;
-        std::cout<<"Trace Size:"<<Trace.size()<<std::endl;
-        bqueue_.setTrace(Trace);
-        bqueue_.process();
+    inittrace(const std::vector<FlowId>& Ids) override {
+        std::cout<<"Trace Size:"<<Ids.size()<<std::endl;
+        bqueue_.setTrace(Ids);
     }
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
+    update_freqs(const FlowId key, uint64_t size){
        //SUPPRESS_UNUSED_WARNING(key);
        //SUPPRESS_UNUSED_WARNING(size);
 
@@ -58,7 +55,7 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    write(const FlowId key, const utils::Packet& packet) override {
         SUPPRESS_UNUSED_WARNING(packet);
         CacheEntry written_entry;
         CacheEntry evicted_entry;
@@ -113,13 +110,12 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        const utils::Packet& packet = queue.back();
-        return write(packet.getFlowId(), packet);
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId(), read.getPacket());
     }
 };
 
@@ -146,6 +142,11 @@ public:
      * Returns the canonical cache name.
      */
     virtual std::string name() const override { return "BeladyCache"; }
+
+    /**
+     * Belady needs the full trace to compute next-request times.
+     */
+    virtual bool requiresFutureKnowledge() const override { return true; }
 };
 
 // Run default benchmarks
@@ -1,16 +1,21 @@
 // STD headers
 #include <assert.h>
+#include <iostream>
 #include <list>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
+// Boost headers
+#include <boost/program_options.hpp>
+
 // Custom headers
 #include "cache_base.hpp"
 #include "cache_common.hpp"
 #include "utils.hpp"
 
 using namespace caching;
+namespace bopt = boost::program_options;
 
 
 /**
@@ -21,31 +26,23 @@ protected:
     PBSQueue<CacheEntry> queue_; // LRU Queue
 
 public:
-    LACacheSet(const size_t num_entries, const size_t misslat) : BaseCacheSet(num_entries,misslat) {queue_.set_Z(misslat);}
+    typedef PBSQueue<CacheEntry>::Objects Objects;
+
+    LACacheSet(const size_t num_entries, const size_t misslat, Objects& objects,
+               const size_t sample_size=0, const InTimes::Config& rate_config=
+               InTimes::Config()) : BaseCacheSet(num_entries,misslat), queue_(objects) {
+        queue_.set_Z(misslat);
+        queue_.setSampleSize(sample_size);
+        queue_.setRateConfig(rate_config);
+    }
     virtual ~LACacheSet() {}
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
     uint64_t UsedSpace = 0;
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
-        if(queue_.LRTs.find(key) != queue_.LRTs.end()){
-            double intertime = (queue_.Timer - queue_.LRTs[key]) / 1.0;
-            queue_.InterTimes[key].recordArrivTimes(intertime);
-            queue_.Lambdas[key] = queue_.InterTimes[key].getLambda();
-        }
-	else{
-            queue_.Lambdas[key] = 0.0;
-        }
-        queue_.LRTs[key] = queue_.Timer;
-        queue_.Timer++;
-
-        if(Sizes1.find(key) == Sizes1.end()){
-            Sizes1[key] = size;
-            queue_.Sizes2[key] = size;
-        }
-
-       return 0;
+    update_freqs(const FlowId key, uint64_t size){
+        queue_.recordArrival(key, size);
+        return 0;
     }
 
 
@@ -57,15 +54,15 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    write(const FlowId key, const utils::Packet& packet) override {
         SUPPRESS_UNUSED_WARNING(packet);
         CacheEntry written_entry;
         CacheEntry evicted_entry;
 
         // If a corresponding entry exists, update it
-        auto position_iter = queue_.positions().find(key);
-        if (position_iter != queue_.positions().end()) {
-            written_entry = *(position_iter->second);
+        const auto& object = queue_.getObject(key);
+        if (object.is_queued) {
+            written_entry = *(object.position);
 
             // Sanity checks
             assert(contains(key));
@@ -74,32 +71,29 @@ public:
 
             // If the read was successful, the corresponding entry is
             // the MRU element in the cache. Remove it from the queue.
-            queue_.erase(position_iter);
+            queue_.erase(key);
             //queue_.insertBack(written_entry);
             // Finally, (re-)insert the written entry at the back
             queue_.insertBack(written_entry);
         }
         // The update was unsuccessful, create a new entry to insert
         else {
-            if(queue_.Lambdas[key] > 0.0){
+            if(object.lambda > 0.0){
                 written_entry.update(key);
                 written_entry.toggleValid();
                 //queue_.insertBack(written_entry);
 
-                // If required, evict the LRU entry
-                if(UsedSpace >= getNumEntries()){
-                   queue_.update_evict();
-                }
+                // If required, evict the lowest-score entries
                 while(UsedSpace >= getNumEntries()){
                     evicted_entry = queue_.popMin();
                     assert(evicted_entry.isValid()); // Sanity check
-                    UsedSpace -= Sizes1[evicted_entry.key()];
+                    UsedSpace -= queue_.getObject(evicted_entry.key()).size;
                     occupied_entries_set_.erase(evicted_entry.key());
                 }
 
                 // Update the occupied entries set
                 occupied_entries_set_.insert(key);
-                UsedSpace += Sizes1[key];
+                UsedSpace += object.size;
 
                 // Finally, (re-)insert the written entry at the back
                 queue_.insertBack(written_entry);
@@ -119,42 +113,164 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        const utils::Packet& packet = queue.back();
-        return write(packet.getFlowId(), packet);
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId(), read.getPacket());
     }
 };
 
 /**
- * Implements a single-tiered LRU cache.
+ * Implements a single-tiered LA cache.
  */
 class LACache : public BaseCache {
-public:
-    LACache(const size_t miss_latency, const size_t cache_set_associativity, const size_t
-             num_cache_sets, const bool penalize_insertions, const HashType hash_type, int
-             argc, char** argv) : BaseCache(miss_latency, cache_set_associativity,
-             num_cache_sets, penalize_insertions, hash_type) {
-        SUPPRESS_UNUSED_WARNING(argc);
-        SUPPRESS_UNUSED_WARNING(argv);
+protected:
+    const size_t kSampleSize; // Entries sampled per eviction (0 = exact eviction)
+    const InTimes::Config kRateConfig; // Arrival rate estimator parameters
+    LACacheSet::Objects objects_; // Per-object metadata, shared by every cache set
 
+    LACache(const size_t miss_latency, const size_t cache_set_associativity, const size_t
+             num_cache_sets, const bool penalize_insertions, const HashType hash_type,
+             const size_t sample_size, const InTimes::Config& rate_config) : BaseCache(
+             miss_latency, cache_set_associativity, num_cache_sets, penalize_insertions,
+             hash_type), kSampleSize(sample_size), kRateConfig(rate_config) {
         // Initialize the cache sets
         for (size_t idx = 0; idx < kMaxNumCacheSets; idx++) {
-            cache_sets_.push_back(new LACacheSet(kCacheSetAssociativity,miss_latency));
+            cache_sets_.push_back(new LACacheSet(kCacheSetAssociativity, miss_latency,
+                                                 objects_, kSampleSize, kRateConfig));
         }
     }
+
+    /**
+     * Internal helper method. Parses the arrival rate estimator parameters.
+     */
+    static InTimes::Config parseRateConfig(int argc, char** argv) {
+        bopt::options_description options{"LACache"};
+        options.add_options()
+            ("lambda", bopt::value<std::string>()->default_value("window"), "Arrival rate estimator (window, ewma)")
+            ("alpha",  bopt::value<double>(), "EWMA weight of the newest inter-arrival time");
+
+        bopt::variables_map variables;
+        bopt::store(bopt::command_line_parser(argc, argv).options(
+            options).allow_unregistered().run(), variables);
+
+        bopt::notify(variables);
+        InTimes::Config config;
+        const std::string mode = variables.at("lambda").as<std::string>();
+        if (mode == "ewma") { config.mode = InTimes::Mode::kEWMA; }
+        else if (mode != "window") {
+            throw std::invalid_argument("Unknown arrival rate estimator: " + mode);
+        }
+        if (variables.count("alpha")) {
+            config.ewma_alpha = variables.at("alpha").as<double>();
+            if (!(config.ewma_alpha > 0 && config.ewma_alpha <= 1)) {
+                throw std::invalid_argument("EWMA weight must be in (0, 1]");
+            }
+        }
+        return config;
+    }
+
+    /**
+     * Internal helper method. Returns the name prefix
+     * corresponding to the arrival rate estimator.
+     */
+    std::string getNamePrefix() const {
+        return (kRateConfig.mode == InTimes::Mode::kEWMA) ? "LAEWMA" : "LA";
+    }
+
+public:
+    LACache(const size_t miss_latency, const size_t cache_set_associativity, const size_t
+             num_cache_sets, const bool penalize_insertions, const HashType hash_type, int
+             argc, char** argv) : LACache(miss_latency, cache_set_associativity,
+             num_cache_sets, penalize_insertions, hash_type, 0,
+             parseRateConfig(argc, argv)) {}
     virtual ~LACache() {}
 
     /**
      * Returns the canonical cache name.
      */
-    virtual std::string name() const override { return "LACache"; }
+    virtual std::string name() const override { return getNamePrefix() + "Cache"; }
+
+    /**
+     * The cache sets only share per-object metadata.
+     */
+    virtual bool hasIndependentSets() const override { return true; }
+};
+
+/**
+ * Implements a single-tiered LA cache with sampled eviction: each
+ * eviction scores K randomly-sampled entries (--samples) and evicts
+ * the lowest-scoring one.
+ */
+class SampledLACache : public LACache {
+private:
+    /**
+     * Internal helper method. Parses the sample size.
+     */
+    static size_t parseSampleSize(int argc, char** argv) {
+        bopt::options_description options{"SampledLACache"};
+        options.add_options()("samples", bopt::value<size_t>(), "Entries sampled per eviction");
+
+        bopt::variables_map variables;
+        bopt::store(bopt::command_line_parser(argc, argv).options(
+            options).allow_unregistered().run(), variables);
+
+        bopt::notify(variables);
+        return variables.at("samples").as<size_t>();
+    }
+
+public:
+    SampledLACache(const size_t miss_latency, const size_t cache_set_associativity, const
+                   size_t num_cache_sets, const bool penalize_insertions, const HashType
+                   hash_type, int argc, char** argv) : LACache(miss_latency,
+                   cache_set_associativity, num_cache_sets, penalize_insertions,
+                   hash_type, parseSampleSize(argc, argv), parseRateConfig(argc, argv)) {}
+    virtual ~SampledLACache() {}
+
+    /**
+     * Returns the canonical cache name.
+     */
+    virtual std::string name() const override {
+        return getNamePrefix() + "S" + std::to_string(kSampleSize) + "Cache";
+    }
 };
 
 // Run default benchmarks
 int main(int argc, char** argv) {
-    BaseCache::defaultBenchmark<LACache>(argc, argv);
+    size_t sample_size = 0;
+    bool is_comparing = false;
+
+    // Command-line arguments
+    bopt::options_description options{"LACache"};
+    options.add_options()
+        ("help",        "Prints this message")
+        ("samples",     bopt::value<size_t>(&sample_size)->default_value(0),    "[Optional] Entries sampled per eviction (0: exact eviction)")
+        ("compare",     bopt::bool_switch(&is_comparing),                       "[Optional] Also run exact eviction, and report the latency gap")
+        ("lambda",      bopt::value<std::string>()->default_value("window"),    "[Optional] Arrival rate estimator: mean of the last 20 inter-arrival times (window), or their EWMA (ewma)")
+        ("alpha",       bopt::value<double>(),                                  "[Optional] EWMA weight of the newest inter-arrival time (default: 2/21)");
+
+    bopt::variables_map variables;
+    bopt::store(bopt::command_line_parser(argc, argv).options(
+        options).allow_unregistered().run(), variables);
+    bopt::notify(variables);
+
+    if (sample_size == 0 || variables.count("help")) {
+        BaseCache::defaultBenchmark<LACache>(argc, argv);
+        if (variables.count("help")) { std::cout << options << std::endl; }
+        return 0;
+    }
+    const size_t sampled_latency = BaseCache::defaultBenchmark<SampledLACache>(argc, argv);
+    if (is_comparing) {
+        const size_t exact_latency = BaseCache::defaultBenchmark<LACache>(argc, argv);
+        const double gap = (exact_latency == 0) ? 0 : 100.0 * (
+            static_cast<double>(sampled_latency) - exact_latency) / exact_latency;
+
+        std::cout << "Sampled (K=" << sample_size << ") total latency: "
+                  << sampled_latency << std::endl;
+        std::cout << "Exact total latency: " << exact_latency << std::endl;
+        std::cout << "Difference: " << std::showpos << gap << std::noshowpos
+                  << "%" << std::endl;
+    }
 }
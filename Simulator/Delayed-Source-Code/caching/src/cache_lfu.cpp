@@ -18,18 +18,18 @@ using namespace caching;
 class LFUCacheSet : public BaseCacheSet {
 protected:
     LFUQueue<CacheEntry> queue_; // LRU Queue
-    std::unordered_map<std::string, uint64_t> Freqs;
-    std::unordered_map<std::string, uint64_t> Caches;
+    std::unordered_map<FlowId, uint64_t> Freqs;
+    std::unordered_map<FlowId, uint64_t> Caches;
 
 public:
     LFUCacheSet(const size_t num_entries, const size_t misslat) : BaseCacheSet(num_entries,misslat) {}
     virtual ~LFUCacheSet() {}
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
+    std::unordered_map<FlowId, uint64_t> Sizes1;
     uint64_t UsedSpace = 0;
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
+    update_freqs(const FlowId key, uint64_t size){
        if(queue_.Freqs.find(key) != queue_.Freqs.end()){
            queue_.Freqs[key] += 1;
        }
@@ -51,7 +51,7 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    write(const FlowId key, const utils::Packet& packet) override {
         SUPPRESS_UNUSED_WARNING(packet);
         CacheEntry written_entry;
         CacheEntry evicted_entry;
@@ -106,13 +106,12 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        const utils::Packet& packet = queue.back();
-        return write(packet.getFlowId(), packet);
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId(), read.getPacket());
     }
 };
 
@@ -139,6 +138,11 @@ public:
      * Returns the canonical cache name.
      */
     virtual std::string name() const override { return "LFUCache"; }
+
+    /**
+     * The cache sets share no policy state.
+     */
+    virtual bool hasIndependentSets() const override { return true; }
 };
 
 // Run default benchmarks
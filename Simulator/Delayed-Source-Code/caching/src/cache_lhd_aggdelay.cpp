@@ -1,7 +1,7 @@
 // STD headers
 #include <assert.h>
 #include <limits>
-#include <list>
+#include <random>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -9,9 +9,11 @@
 // Custom headers
 #include "cache_base.hpp"
 #include "cache_common.hpp"
+#include "cache_lhd.hpp"
 #include "utils.hpp"
 
 using namespace caching;
+namespace bopt = boost::program_options;
 
 /**
  * Placeholder random number generator from Knuth MMIX.
@@ -78,43 +80,98 @@ struct FlowMetadata {
     size_t last_last_hit_age = 0;
 };
 
-/**
- * Per-class metadata.
- */
-struct ClassMetadata {
-    double total_hits = 0;
-    double total_evictions = 0;
-
-    std::vector<double> hits;
-    std::vector<double> evictions;
-    std::vector<double> hit_densities;
-};
-
 /**
  * Represents a single set (row) in a LHDAggregateDelay-based cache.
+ *
+ * Flow records are kept in a dense slot array, so that eviction
+ * candidates can be sampled uniformly in O(1). With a sample size
+ * of 0, every cached flow is considered on each eviction.
  */
 template<class T>
 class LHDAggregateDelayCacheSet : public BaseCacheSet {
 private:
+    static constexpr size_t kNoSlot = std::numeric_limits<size_t>::max();
+
     T& kCacheImpl; // Reference to the cache implementation
-    std::unordered_map<std::string, FlowMetadata> records_; // Dict mapping flow IDs to records
-    std::unordered_map<std::string, CacheEntry> entries_; // Dict mapping flow IDs to CacheEntries
+    std::vector<FlowId> slot_keys_; // Dense array of cached flow IDs
+    std::vector<FlowMetadata> records_; // Flow records, by slot
+    std::vector<size_t> slot_indices_; // Slot of each cached flow, by FlowId
+    size_t sample_size_ = 0; // Candidates sampled per eviction (0 = all)
+    std::mt19937_64 generator_; // Sampling PRNG (fixed seed)
 
     // Explorer objects
     int64_t explorer_budget_ = 0;
     static constexpr double kExplorerBudgetFraction = 0.01;
 
+    /**
+     * Internal helper method. Returns the record for the given flow.
+     */
+    FlowMetadata& getRecord(const FlowId key) {
+        assert(key < slot_indices_.size() && slot_indices_[key] != kNoSlot);
+        return records_[slot_indices_[key]];
+    }
+
+    /**
+     * Internal helper methods. Add (or remove) a flow's slot.
+     */
+    void addSlot(const FlowId key) {
+        if (key >= slot_indices_.size()) { slot_indices_.resize(key + 1, kNoSlot); }
+        slot_indices_[key] = slot_keys_.size();
+        slot_keys_.push_back(key);
+        records_.emplace_back();
+    }
+    void removeSlot(const FlowId key) {
+        const size_t idx = slot_indices_[key];
+        slot_keys_[idx] = slot_keys_.back();
+        records_[idx] = records_.back();
+        slot_indices_[slot_keys_[idx]] = idx;
+        slot_keys_.pop_back();
+        records_.pop_back();
+        slot_indices_[key] = kNoSlot;
+    }
+
+    /**
+     * Internal helper method. Returns the slot of the cached flow with
+     * the lowest payoff, among either every cached flow, or (in
+     * sampled mode) sample_size_ randomly-sampled ones. Sets holding
+     * no more than sample_size_ flows are always scanned in full.
+     */
+    size_t getVictimSlot() {
+        assert(!slot_keys_.empty());
+        double min_cost = std::numeric_limits<double>::max();
+        size_t victim = kNoSlot;
+
+        const bool is_sampling = (sample_size_ > 0 &&
+                                  sample_size_ < slot_keys_.size());
+        std::uniform_int_distribution<size_t> distribution(0, slot_keys_.size() - 1);
+        const size_t num_candidates = is_sampling ? sample_size_ : slot_keys_.size();
+        for (size_t idx = 0; idx < num_candidates; idx++) {
+            const size_t candidate = is_sampling ? distribution(generator_) : idx;
+            const double candidate_cost = kCacheImpl.getHitDensityPayoff(
+                slot_keys_[candidate], records_[candidate]);
+
+            // If this flow incurs the smallest delay cost, evict it
+            if (victim == kNoSlot || candidate_cost < min_cost) {
+                min_cost = candidate_cost;
+                victim = candidate;
+            }
+        }
+        return victim;
+    }
+
 public:
-    LHDAggregateDelayCacheSet(const size_t num_entries, const size_t misslat, T& cache) :
-                              BaseCacheSet(num_entries,misslat), kCacheImpl(cache) {
+    LHDAggregateDelayCacheSet(const size_t num_entries, const size_t misslat, T& cache,
+                              const size_t sample_size=0) : BaseCacheSet(num_entries,
+                              misslat), kCacheImpl(cache), sample_size_(sample_size),
+                              generator_(12345) {
         explorer_budget_ = num_entries * kExplorerBudgetFraction;
     }
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
+    std::unordered_map<FlowId, uint64_t> Sizes1;
     uint64_t UsedSpace = 0;
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
+    update_freqs(const FlowId key, uint64_t size){
        //SUPPRESS_UNUSED_WARNING(key);
        //SUPPRESS_UNUSED_WARNING(size);
        if(Sizes1.find(key) == Sizes1.end()){
@@ -123,6 +180,7 @@ public:
        return 0;
     }
 
+
     /**
      * Simulates a cache write.
      *
@@ -130,71 +188,39 @@ public:
      * @param packet The packet corresponding to this write request.
      * @return The written CacheEntry instance.
      */
-    virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    virtual CacheEntry write(const FlowId key,
+                             const utils::Packet& packet) override {
         CacheEntry written_entry;
+        written_entry.update(key);
+        written_entry.toggleValid();
 
-        // If a corresponding entry exists, update it
-        if (contains(key)) {
-            written_entry = entries_.at(key);
-
-            // Sanity checks
-            assert(contains(key));
-            assert(written_entry.isValid());
-            assert(written_entry.key() == key);
-        }
-        // The update was unsuccessful, create a new entry to insert
-        else {
-            written_entry.update(key);
-            written_entry.toggleValid();
-
+        // The flow is not cached, insert it
+        const bool insert = !contains(key);
+        if (insert) {
             // If required, evict the entry with lowest cost
             //if (entries_.size() == getNumEntries()) {
             while(UsedSpace >= getNumEntries()){
-                double min_cost = std::numeric_limits<double>::max();
-                std::string flow_id_to_evict = "-1";
-                //std::cout<<"1 "<<min_cost<<std::endl;
-
-                double candidate_cost = 0.0;
-                for (const auto& pair : entries_) {
-                    // Compute the hit density for this flow
-                    const std::string& candidate = pair.first;
-                    candidate_cost = kCacheImpl.getHitDensityPayoff(
-                        candidate, records_.at(candidate));
-
-                    // If this flow incurs the smallest delay cost, evict it
-                    if (candidate_cost < min_cost) {
-                        min_cost = candidate_cost;
-                        flow_id_to_evict = candidate;
-                    }
-                    
-                }
-                //std::cout<<candidate_cost<<std::endl;
-                //std::cout<<"2 "<<flow_id_to_evict<<" "<<UsedSpace<<" "<<entries_.size()<<" "<<min_cost<<std::endl;
+                const size_t victim = getVictimSlot();
+                const FlowId flow_id_to_evict = slot_keys_[victim];
+
                 // Update the flow record before erasure
-                kCacheImpl.replaced(records_,flow_id_to_evict, explorer_budget_);
+                kCacheImpl.replaced(records_[victim], explorer_budget_);
 
-                //std::cout<<"3"<<std::endl;
                 // Evict the corresponding entry
-                auto evicted_entry = entries_.at(flow_id_to_evict);
+                removeSlot(flow_id_to_evict);
                 occupied_entries_set_.erase(flow_id_to_evict);
-                entries_.erase(flow_id_to_evict);
                 UsedSpace -= Sizes1[flow_id_to_evict];
-                assert(evicted_entry.isValid());
             }
-            //std::cout<<"------"<<std::endl;
             // Insert the written entry into the cache
-            entries_[key] = written_entry;
+            addSlot(key);
             occupied_entries_set_.insert(key);
             UsedSpace += Sizes1[key];
         }
-        kCacheImpl.update(records_, packet, explorer_budget_);
-        
+        kCacheImpl.update(getRecord(key), insert, packet, explorer_budget_);
 
         // Sanity checks
         assert(occupied_entries_set_.size() <= getNumEntries());
-        assert(occupied_entries_set_.size() == entries_.size());
-        assert(records_.size() == entries_.size());
+        assert(occupied_entries_set_.size() == slot_keys_.size());
 
         return written_entry;
     }
@@ -205,25 +231,27 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        CacheEntry written_entry;
-
-        for (auto iter = queue.begin(); iter != queue.end(); iter++) {
-            // For the first packet in the queue, perform a full write
-            if (iter == queue.begin()) {
-                written_entry = write(iter->getFlowId(), *iter);
-                assert(written_entry.isValid()); // Sanity check
-                assert(records_.find(iter->getFlowId()) != records_.end());
-            }
-            // For the remaining packets, simply perform updates
-            else { kCacheImpl.update(records_, *iter, explorer_budget_); }
+    writeq(const InFlightRead& read) override {
+        // For the first packet in the queue, perform a full write
+        CacheEntry written_entry = write(read.getFlowId(), read.getPacket());
+        assert(written_entry.isValid()); // Sanity check
+
+        // For the remaining packets, simply perform updates
+        FlowMetadata& data = getRecord(read.getFlowId());
+        for (const auto& packet : read.getDelayedPackets()) {
+            kCacheImpl.update(data, false, packet, explorer_budget_);
         }
         return written_entry;
     }
+
+    /**
+     * LHD replays every delayed hit as a hit on the written entry.
+     */
+    virtual bool needsQueuedPackets() const override { return true; }
 };
 
 /**
@@ -253,39 +281,47 @@ private:
     size_t num_reconfigurations_ = 0;
     size_t age_coarsening_shift_ = 10;
     double ewma_num_objects_mass_ = 0;
-    std::vector<ClassMetadata> classes_; // List of object classes
-    std::unordered_map<std::string, FlowState> states_; // Dict mapping flow IDs to states
+    LHDHitDensityModel model_; // Per-class hit-density model
+    size_t sample_size_ = 0; // Entries sampled per eviction (0 = exact eviction)
+    utils::FlatHashMap<FlowId, FlowState> states_; // Dict mapping flow IDs to states
 
 public:
     LHDAggregateDelayCache(const size_t miss_latency, const size_t cache_set_associativity,
                            const size_t num_cache_sets, const bool penalize_insertions,
                            const HashType hash_type, int argc, char** argv) : BaseCache(
                            miss_latency, cache_set_associativity, num_cache_sets,
-                           penalize_insertions, hash_type), rand(12345) {
-        SUPPRESS_UNUSED_WARNING(argc);
-        SUPPRESS_UNUSED_WARNING(argv);
+                           penalize_insertions, hash_type), rand(12345),
+                           model_(kNumClassesTotal, kMaxAge, kEWMADecay) {
+        // Command-line arguments
+        bopt::options_description options{"LHDAggregateDelayCache"};
+        options.add_options()
+            ("samples",      bopt::value<size_t>()->default_value(0), "Entries sampled per eviction (0: exact eviction)")
+            ("syncreconfig", bopt::bool_switch(),                     "Reconfigure the hit-density model inline");
+
+        // Parse model parameters
+        bopt::variables_map variables;
+        bopt::store(bopt::command_line_parser(argc, argv).options(
+            options).allow_unregistered().run(), variables);
+
+        bopt::notify(variables);
+        sample_size_ = variables.at("samples").as<size_t>();
+        model_.setBackground(!variables.at("syncreconfig").as<bool>());
 
         next_reconfiguration_ = kAccessesPerReconfiguration;
-        for (size_t i = 0; i < kNumClassesTotal; i++) {
-            classes_.push_back(ClassMetadata());
-            auto& cl = classes_.back();
-            cl.hits.resize(kMaxAge, 0);
-            cl.evictions.resize(kMaxAge, 0);
-            cl.hit_densities.resize(kMaxAge, 0);
-        }
 
         // Initialize policy to ~GDSF by default
         for (size_t c = 0; c < kNumClassesTotal; c++) {
             for (size_t a = 0; a < kMaxAge; a++) {
-                classes_[c].hit_densities[a] =
-                    1. * (c + 1) / (a + 1);
+                model_.setInitialHitDensity(c, a,
+                    1. * (c + 1) / (a + 1));
             }
         }
 
         // Initialize the cache sets
         for (size_t idx = 0; idx < kMaxNumCacheSets; idx++) {
             cache_sets_.push_back(new LHDAggregateDelayCacheSet
-                <LHDAggregateDelayCache>(kCacheSetAssociativity, miss_latency, *this));
+                <LHDAggregateDelayCache>(kCacheSetAssociativity, miss_latency,
+                                         *this, sample_size_));
         }
     }
     virtual ~LHDAggregateDelayCache() {}
@@ -293,7 +329,10 @@ public:
     /**
      * Returns the canonical cache name.
      */
-    virtual std::string name() const override { return "LHDADCache"; }
+    virtual std::string name() const override {
+        return (sample_size_ == 0) ? "LHDADCache" :
+            "LHDADS" + std::to_string(sample_size_) + "Cache";
+    }
 
     /**
      * Records arrival of a new packet.
@@ -323,13 +362,6 @@ public:
         return hitAgeClass(data.last_hit_age + data.last_last_hit_age);
     }
 
-    /**
-     * Returns the class corresponding to the given flow.
-     */
-    inline ClassMetadata& getClass(const FlowMetadata& data) {
-        return classes_[getClassId(data)];
-    }
-
     /**
      * Returns the age for the given flow.
      */
@@ -347,7 +379,7 @@ public:
     /**
      * Returns the payoff corresponding to the given flow.
      */
-    inline double getHitDensityPayoff(const std::string& id,
+    inline double getHitDensityPayoff(const FlowId id,
                                       const FlowMetadata& data) {
         const size_t age = getAge(data);
         if (age == kMaxAge - 1) {
@@ -356,54 +388,14 @@ public:
         //else if (data.explorer) {
         //    return std::numeric_limits<double>::max();
         //}
-        const ClassMetadata& cl = getClass(data);
-        const double density = cl.hit_densities[age];
+        const double density = model_.getHitDensity(getClassId(data), age);
         const double aggdelay = states_.at(id).getAverageAggregateDelay(kCacheMissLatency);
 
         return aggdelay * density;
     }
 
     void reconfigure() {
-        for (auto& cl : classes_) {
-            updateClass(cl);
-        }
-        adaptAgeCoarsening();
-        modelHitDensity();
-    }
-
-    void updateClass(ClassMetadata& cl) {
-        cl.total_hits = 0;
-        cl.total_evictions = 0;
-
-        for (size_t age = 0; age < kMaxAge; age++) {
-            cl.hits[age] *= kEWMADecay;
-            cl.evictions[age] *= kEWMADecay;
-
-            cl.total_hits += cl.hits[age];
-            cl.total_evictions += cl.evictions[age];
-        }
-    }
-
-    void modelHitDensity() {
-        for (size_t c = 0; c < classes_.size(); c++) {
-            double total_events = classes_[c].hits[kMaxAge-1] + classes_[c].evictions[kMaxAge-1];
-            double total_hits = classes_[c].hits[kMaxAge-1];
-            double lifetime_unconditioned = total_events;
-
-            // We use a small trick here to compute expectation
-            // in O(N) by accumulating all values at later ages.
-            for (size_t a = kMaxAge - 2; a < kMaxAge; a--) {
-                total_hits += classes_[c].hits[a];
-                total_events += classes_[c].hits[a] + classes_[c].evictions[a];
-
-                lifetime_unconditioned += total_events;
-                if (total_events > 1e-5) {
-                    classes_[c].hit_densities[a] = total_hits / lifetime_unconditioned;
-                } else {
-                    classes_[c].hit_densities[a] = 0.;
-                }
-            }
-        }
+        model_.reconfigure(adaptAgeCoarsening());
     }
 
     /**
@@ -413,8 +405,11 @@ public:
      * how big your objects are. to make LHD run on different traces
      * without needing to configure this, we set the age coarsening
      * automatically near the beginning of the trace.
+     *
+     * Returns the change in age coarsening (as a power of two), by which
+     * the age distributions must be compressed (or stretched, if < 0).
      */
-    void adaptAgeCoarsening() {
+    int32_t adaptAgeCoarsening() {
         ewma_num_objects_ *= kEWMADecay;
         ewma_num_objects_mass_ *= kEWMADecay;
 
@@ -442,58 +437,22 @@ public:
             ewma_num_objects_ *= 8;
             ewma_num_objects_mass_ *= 8;
 
-            // Compress or stretch distributions to approximate new scaling regime
-            if (delta < 0) {
-                // Stretch
-                for (auto& cl : classes_) {
-                    for (size_t a = kMaxAge >> (-delta); a < kMaxAge - 1; a++) {
-                        cl.hits[kMaxAge - 1] += cl.hits[a];
-                        cl.evictions[kMaxAge - 1] += cl.evictions[a];
-                    }
-                    for (size_t a = kMaxAge - 2; a < kMaxAge; a--) {
-                        cl.hits[a] = cl.hits[a >> (-delta)] / (1 << (-delta));
-                        cl.evictions[a] = cl.evictions[a >> (-delta)] / (1 << (-delta));
-                    }
-                }
-            } else if (delta > 0) {
-                // Compress
-                for (auto& cl : classes_) {
-                    for (size_t a = 0; a < kMaxAge >> delta; a++) {
-                        cl.hits[a] = cl.hits[a << delta];
-                        cl.evictions[a] = cl.evictions[a << delta];
-                        for (int i = 1; i < (1 << delta); i++) {
-                            cl.hits[a] += cl.hits[(a << delta) + i];
-                            cl.evictions[a] += cl.evictions[(a << delta) + i];
-                        }
-                    }
-                    for (size_t a = (kMaxAge >> delta); a < kMaxAge - 1; a++) {
-                        cl.hits[a] = 0;
-                        cl.evictions[a] = 0;
-                    }
-                }
-            }
+            // The model compresses or stretches the distributions
+            // to approximate the new scaling regime.
+            return delta;
         }
+        return 0;
     }
-    void update(std::unordered_map<std::string, FlowMetadata>& records,
+    void update(FlowMetadata& data, const bool insert,
                 const utils::Packet& packet, int64_t& explorer_budget) {
-        const std::string& id = packet.getFlowId();
-        auto iter = records.find(id);
-
-        bool insert = (iter == records.end());
         if (insert) {
-            FlowMetadata& data = records[id];
             data.clk = packet.getArrivalClock();
             data.last_last_hit_age = kMaxAge;
             data.last_hit_age = 0;
-
-            iter = records.find(id);
-            assert(iter != records.end());
         }
         else {
-            FlowMetadata& data = iter->second;
-            ClassMetadata& cl = getClass(data);
             auto age = getAge(data);
-            cl.hits[age] += 1;
+            model_.recordHit(getClassId(data), age);
 
             if (data.explorer) { explorer_budget += 1; }
             data.last_last_hit_age = data.last_hit_age;
@@ -505,12 +464,13 @@ public:
         // ... but limit how many resources we spend on doing this.
         bool explore = (rand.next() % kExploreInverseProbability) == 0;
         if (explore && explorer_budget > 0 && num_reconfigurations_ < 50) {
-            iter->second.explorer = true;
+            data.explorer = true;
             explorer_budget -= 1;
         } else {
-            iter->second.explorer = false;
+            data.explorer = false;
         }
 
+        model_.recordAccess();
         if (--next_reconfiguration_ == 0) {
             reconfigure();
             ++num_reconfigurations_;
@@ -518,19 +478,12 @@ public:
         }
     }
 
-    void replaced(std::unordered_map<std::string, FlowMetadata>& records,
-                  const std::string& id, int64_t& explorer_budget) {
-        auto iter = records.find(id);
-        assert(iter != records.end());
-
+    void replaced(const FlowMetadata& data, int64_t& explorer_budget) {
         // Record stats before removing item
-        const FlowMetadata& data = iter->second;
-        ClassMetadata& cl = getClass(data);
         auto age = getAge(data);
-        cl.evictions[age] += 1;
+        model_.recordEviction(getClassId(data), age);
 
         if (data.explorer) { explorer_budget += 1; }
-        records.erase(iter);
     }
 };
 
@@ -23,11 +23,11 @@ public:
     LRUCacheSet(const size_t num_entries, const size_t misslat) : BaseCacheSet(num_entries,misslat) {}
     virtual ~LRUCacheSet() {}
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
+    std::unordered_map<FlowId, uint64_t> Sizes1;
     uint64_t UsedSpace = 0;
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
+    update_freqs(const FlowId key, uint64_t size){
        //SUPPRESS_UNUSED_WARNING(key);
        //SUPPRESS_UNUSED_WARNING(size);
        if(Sizes1.find(key) == Sizes1.end()){
@@ -45,7 +45,7 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    write(const FlowId key, const utils::Packet& packet) override {
         SUPPRESS_UNUSED_WARNING(packet);
         CacheEntry written_entry;
         CacheEntry evicted_entry;
@@ -55,7 +55,7 @@ public:
         // If a corresponding entry exists, update it
         auto position_iter = queue_.positions().find(key);
         if (position_iter != queue_.positions().end()) {
-            written_entry = *(position_iter->second);
+            written_entry = queue_.entries()[position_iter->second];
 
             // Sanity checks
             assert(contains(key));
@@ -63,8 +63,8 @@ public:
             assert(written_entry.key() == key);
 
             // If the read was successful, the corresponding entry is
-            // the MRU element in the cache. Remove it from the queue.
-            queue_.erase(position_iter);
+            // the MRU element in the cache. Move it to the back.
+            queue_.moveToBack(position_iter);
         }
         // The update was unsuccessful, create a new entry to insert
         else {
@@ -83,10 +83,10 @@ public:
             // Update the occupied entries set
             occupied_entries_set_.insert(key);
             UsedSpace += Sizes1[key];
-        }
 
-        // Finally, (re-)insert the written entry at the back
-        queue_.insertBack(written_entry);
+            // Finally, insert the written entry at the back
+            queue_.insertBack(written_entry);
+        }
 
         // Sanity checks
         assert(occupied_entries_set_.size() <= getNumEntries());
@@ -100,13 +100,12 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        const utils::Packet& packet = queue.back();
-        return write(packet.getFlowId(), packet);
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId(), read.getPacket());
     }
 };
 
@@ -133,6 +132,11 @@ public:
      * Returns the canonical cache name.
      */
     virtual std::string name() const override { return "LRUCache"; }
+
+    /**
+     * The cache sets share no policy state.
+     */
+    virtual bool hasIndependentSets() const override { return true; }
 };
 
 // Run default benchmarks
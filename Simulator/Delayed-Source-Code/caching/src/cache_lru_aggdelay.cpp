@@ -1,7 +1,7 @@
 // STD headers
+#include <algorithm>
 #include <assert.h>
-#include <limits>
-#include <list>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -9,6 +9,7 @@
 // Custom headers
 #include "cache_base.hpp"
 #include "cache_common.hpp"
+#include "flat_hash_map.hpp"
 #include "utils.hpp"
 
 using namespace caching;
@@ -44,15 +45,199 @@ public:
         last_packet_idx_ = idx;
         num_packets_++;
     }
+    /**
+     * Returns the mean AggregateDelay per queueing window.
+     */
+    double getWindowedAggDelay() const {
+        return (static_cast<double>(cumulative_aggdelay_) / num_windows_);
+    }
+    /**
+     * Returns the arrival clock of this flow's last packet.
+     */
+    size_t getLastPacketIdx() const { return last_packet_idx_; }
     /**
      * Returns the payoff for this flow.
      */
     double getExpectedPayoff(const size_t clk) const {
-        const double windowed_aggdelay = (
-            static_cast<double>(cumulative_aggdelay_) /
-            num_windows_);
+        return (getWindowedAggDelay() / (clk - last_packet_idx_ + 1));
+    }
+};
+
+/**
+ * Implements a kinetic tournament tree that tracks the cached flow
+ * with the lowest expected payoff (ties go to the LRU flow).
+ *
+ * Payoffs decay with the clock, so two flows may swap order without
+ * either of them being accessed. However, the sign of their payoff
+ * difference is linear in the clock, so a pair swaps at most once
+ * between updates, at a clock that can be computed in advance. Each
+ * internal node caches the winner of its two children, along with the
+ * earliest clock at which any outcome in its subtree may change. A
+ * query only revisits subtrees whose outcome may have changed (due to
+ * such an event, or to an updated flow), rather than every flow.
+ */
+class PayoffTournament {
+private:
+    typedef uint32_t Slot;
+    static constexpr size_t kNever = SIZE_MAX;
+    static constexpr size_t kMinNumLeaves = 64;
+
+    struct Node {
+        FlowId winner = utils::kInvalidFlowId; // Lowest-payoff flow in this subtree
+        size_t event = kNever; // Earliest clock at which the subtree may change
+    };
+    const std::vector<FlowMetadata>& kRecords; // Flow records, by FlowId
+    std::vector<Node> nodes_; // Tree nodes (root at 1, leaves at num_leaves_ + slot)
+    utils::FlatHashMap<FlowId, Slot> slots_; // Leaf slot of each flow
+    std::vector<Slot> free_slots_; // Unoccupied leaf slots
+    size_t num_leaves_ = 0; // Leaf capacity (a power of 2)
+    size_t size_ = 0; // Number of flows in the tree
 
-        return (windowed_aggdelay / (clk - last_packet_idx_ + 1));
+    /**
+     * Internal helper method. Whether flow a should be evicted before b.
+     */
+    bool isBetter(const FlowId a, const FlowId b, const size_t clk) const {
+        const double payoff_a = kRecords[a].getExpectedPayoff(clk);
+        const double payoff_b = kRecords[b].getExpectedPayoff(clk);
+        if (payoff_a != payoff_b) { return (payoff_a < payoff_b); }
+        return (kRecords[a].getLastPacketIdx() < kRecords[b].getLastPacketIdx());
+    }
+
+    /**
+     * Internal helper method. Returns a clock no later than the first
+     * one at which the loser's payoff drops below the winner's.
+     */
+    size_t getSwapClock(const FlowId winner, const FlowId loser, const size_t clk) const {
+        const FlowMetadata& w = kRecords[winner];
+        const FlowMetadata& l = kRecords[loser];
+        const double aggdelay_w = w.getWindowedAggDelay();
+        const double aggdelay_l = l.getWindowedAggDelay();
+
+        // The winner's payoff decays no slower; it keeps winning
+        if (aggdelay_w <= aggdelay_l) { return kNever; }
+
+        // Solve for the crossover, in clock cycles from now. The result
+        // is rounded down (less a cycle of slack for rounding error), so
+        // that an early estimate merely costs an extra comparison.
+        const double gap = (
+            (aggdelay_l * (clk - w.getLastPacketIdx() + 1)) -
+            (aggdelay_w * (clk - l.getLastPacketIdx() + 1))) /
+            (aggdelay_w - aggdelay_l);
+
+        if (gap >= 1e18) { return kNever; }
+        return clk + ((gap > 2) ? (static_cast<size_t>(gap) - 1) : 1);
+    }
+
+    /**
+     * Internal helper method. Recomputes every outcome in the subtree
+     * rooted at idx that may have changed on or before the given clock.
+     */
+    void advance(const size_t idx, const size_t clk) {
+        Node& node = nodes_[idx];
+        if (node.event > clk) { return; } // Also true for every leaf
+
+        const size_t left = (2 * idx);
+        const size_t right = (left + 1);
+        advance(left, clk);
+        advance(right, clk);
+
+        const FlowId a = nodes_[left].winner;
+        const FlowId b = nodes_[right].winner;
+        size_t event = kNever;
+        if (a == utils::kInvalidFlowId) { node.winner = b; }
+        else if (b == utils::kInvalidFlowId) { node.winner = a; }
+        else {
+            const bool is_left_winner = isBetter(a, b, clk);
+            node.winner = is_left_winner ? a : b;
+            event = getSwapClock(node.winner, is_left_winner ? b : a, clk);
+        }
+        node.event = std::min({event, nodes_[left].event, nodes_[right].event});
+    }
+
+    /**
+     * Internal helper method. Marks the ancestors of the given slot for
+     * recomputation. Since a node's event clock never exceeds those of
+     * its children, this stops at the first already-marked ancestor.
+     */
+    void invalidate(const Slot slot) {
+        for (size_t idx = (num_leaves_ + slot) / 2;
+             idx > 0 && nodes_[idx].event != 0; idx /= 2) {
+            nodes_[idx].event = 0;
+        }
+    }
+
+    /**
+     * Internal helper method. Doubles the leaf capacity.
+     */
+    void grow() {
+        const size_t num_leaves = std::max(kMinNumLeaves, 2 * num_leaves_);
+        std::vector<Node> nodes(2 * num_leaves);
+        for (size_t slot = 0; slot < num_leaves_; slot++) {
+            nodes[num_leaves + slot] = nodes_[num_leaves_ + slot];
+        }
+        // Every internal node must be recomputed
+        for (size_t idx = 1; idx < num_leaves; idx++) { nodes[idx].event = 0; }
+        for (size_t slot = num_leaves; slot > num_leaves_; slot--) {
+            free_slots_.push_back(static_cast<Slot>(slot - 1));
+        }
+        nodes_.swap(nodes);
+        num_leaves_ = num_leaves;
+    }
+
+public:
+    explicit PayoffTournament(const std::vector<FlowMetadata>& records) :
+                              kRecords(records) {}
+
+    // Accessors
+    size_t size() const { return size_; }
+    bool contains(const FlowId key) const {
+        return (slots_.find(key) != slots_.end());
+    }
+
+    /**
+     * Inserts the given flow.
+     */
+    void insert(const FlowId key) {
+        assert(!contains(key));
+        if (free_slots_.empty()) { grow(); }
+        const Slot slot = free_slots_.back();
+        free_slots_.pop_back();
+
+        slots_.emplace(key, slot);
+        nodes_[num_leaves_ + slot].winner = key;
+        invalidate(slot);
+        size_++;
+    }
+
+    /**
+     * Erases the given flow.
+     */
+    void erase(const FlowId key) {
+        assert(contains(key));
+        auto slot_iter = slots_.find(key);
+        const Slot slot = slot_iter->second;
+        slots_.erase(slot_iter);
+        nodes_[num_leaves_ + slot].winner = utils::kInvalidFlowId;
+        free_slots_.push_back(slot);
+        invalidate(slot);
+        size_--;
+    }
+
+    /**
+     * Indicates that the given flow's record was updated.
+     */
+    void update(const FlowId key) {
+        auto slot_iter = slots_.find(key);
+        if (slot_iter != slots_.end()) { invalidate(slot_iter->second); }
+    }
+
+    /**
+     * Returns the flow with the lowest payoff at the given clock.
+     */
+    FlowId top(const size_t clk) {
+        assert(size_ > 0);
+        advance(1, clk);
+        return nodes_[1].winner;
     }
 };
 
@@ -62,14 +247,14 @@ public:
 class LRUAggregateDelayCacheSet : public BaseCacheSet {
 private:
     const BaseCache& kCacheImpl; // Reference to the cache implementation
-    std::unordered_map<std::string, FlowMetadata> records_; // Dict mapping flow IDs to records
-    std::unordered_map<std::string, CacheEntry> entries_; // Dict mapping flow IDs to CacheEntries
+    std::vector<FlowMetadata>& records_; // Flow records, by FlowId (shared by every cache set)
+    PayoffTournament candidates_; // Cached flows, ranked by payoff
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
+    std::unordered_map<FlowId, uint64_t> Sizes1;
     uint64_t UsedSpace = 0;
 
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
+    update_freqs(const FlowId key, uint64_t size){
        //SUPPRESS_UNUSED_WARNING(key);
        //SUPPRESS_UNUSED_WARNING(size);
        if(Sizes1.find(key) == Sizes1.end()){
@@ -82,66 +267,54 @@ private:
     /**
      * Internal helper method.
      */
-    CacheEntry write(const std::string& key) {
+    CacheEntry write(const FlowId key) {
         CacheEntry written_entry;
 
-        // If a corresponding entry exists, update it
-        if (contains(key)) {
-            written_entry = entries_.at(key);
+        written_entry.update(key);
+        written_entry.toggleValid();
 
-            // Sanity checks
-            assert(contains(key));
-            assert(written_entry.isValid());
-            assert(written_entry.key() == key);
-        }
-        // The update was unsuccessful, create a new entry to insert
-        else {
-            written_entry.update(key);
-            written_entry.toggleValid();
+        // If a corresponding entry exists, there is nothing to update
+        if (contains(key)) { assert(candidates_.contains(key)); }
 
+        // Else, insert a new entry
+        else {
             // If required, evict the entry with lowest cost
-            //if (entries_.size() == getNumEntries()) {
             while(UsedSpace >= getNumEntries()){
-                double min_cost = std::numeric_limits<double>::max();
-                std::string flow_id_to_evict;
-                for (const auto& pair : entries_) {
-                    const std::string& candidate = pair.first;
-                    const double candidate_cost = (records_.at(
-                        candidate).getExpectedPayoff(kCacheImpl.clk()));
-
-                    // If this flow incurs the smallest delay cost, evict it
-                    if (candidate_cost < min_cost) {
-                        min_cost = candidate_cost;
-                        flow_id_to_evict = candidate;
-                    }
-                }
+                const FlowId flow_id_to_evict = candidates_.top(kCacheImpl.clk());
+
                 // Evict the corresponding entry
                 occupied_entries_set_.erase(flow_id_to_evict);
-                entries_.erase(flow_id_to_evict);
+                candidates_.erase(flow_id_to_evict);
                 UsedSpace -= Sizes1[flow_id_to_evict];
             }
             // Update the cache
-            entries_[key] = written_entry;
+            candidates_.insert(key);
             occupied_entries_set_.insert(key);
             UsedSpace += Sizes1[key];
         }
         // Sanity checks
         assert(occupied_entries_set_.size() <= getNumEntries());
-        assert(occupied_entries_set_.size() == entries_.size());
+        assert(occupied_entries_set_.size() == candidates_.size());
         return written_entry;
     }
 
 public:
-    LRUAggregateDelayCacheSet(const size_t num_entries, const size_t misslat, const BaseCache& cache) :
-                              BaseCacheSet(num_entries,misslat), kCacheImpl(cache) {}
+    LRUAggregateDelayCacheSet(const size_t num_entries, const size_t misslat, const BaseCache& cache,
+                              std::vector<FlowMetadata>& records) : BaseCacheSet(num_entries,misslat),
+                              kCacheImpl(cache), records_(records), candidates_(records) {}
     virtual ~LRUAggregateDelayCacheSet() {}
 
     /**
      * Records arrival of a new packet.
      */
     virtual void recordPacketArrival(const utils::Packet& packet) override {
-        records_[packet.getFlowId()].recordPacketArrival(
+        const FlowId key = packet.getFlowId();
+        if (key >= records_.size()) { records_.resize(key + 1); }
+        records_[key].recordPacketArrival(
             packet.getArrivalClock(), kCacheImpl.getCacheMissLatency());
+
+        // The flow's payoff changed; re-rank it
+        candidates_.update(key);
     }
 
     /**
@@ -152,7 +325,7 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    write(const FlowId key, const utils::Packet& packet) override {
         SUPPRESS_UNUSED_WARNING(packet);
         return write(key);
     }
@@ -163,12 +336,12 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        return write(queue.front().getFlowId());
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId());
     }
 };
 
@@ -178,6 +351,7 @@ public:
 class LRUAggregateDelayCache : public BaseCache {
 private:
     double beta_inv_; // Inverse of the Beta-parameter defined in GD*
+    std::vector<FlowMetadata> records_; // Flow records, by FlowId (shared by every cache set)
 
 public:
     LRUAggregateDelayCache(const size_t miss_latency, const size_t cache_set_associativity,
@@ -191,7 +365,7 @@ public:
         // Initialize the cache sets
         for (size_t idx = 0; idx < kMaxNumCacheSets; idx++) {
             cache_sets_.push_back(new LRUAggregateDelayCacheSet(
-                kCacheSetAssociativity, miss_latency, *this));
+                kCacheSetAssociativity, miss_latency, *this, records_));
         }
     }
     virtual ~LRUAggregateDelayCache() {}
@@ -200,6 +374,11 @@ public:
      * Returns the canonical cache name.
      */
     virtual std::string name() const override { return "LRUADCache"; }
+
+    /**
+     * The cache sets only share per-flow records.
+     */
+    virtual bool hasIndependentSets() const override { return true; }
 };
 
 // Run default benchmarks
@@ -0,0 +1,326 @@
+// STD headers
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Boost headers
+#include <boost/program_options.hpp>
+
+// Custom headers
+#include "latency_histogram.hpp"
+#include "trace_reader.hpp"
+#include "utils.hpp"
+
+using utils::FlowId;
+
+/**
+ * Computes byte-weighted LRU stack distances in a single pass.
+ *
+ * The stack distance of a request is the total size of the distinct
+ * flows requested since the previous request to the same flow (i.e.,
+ * the bytes ahead of it in the LRU stack). Following Olken, each flow
+ * is represented only at the slot of its last access, weighted by its
+ * size, in a Fenwick tree over access slots; the distance is then a
+ * range sum over the slots since the flow's previous access. Slots are
+ * compacted (in access order) whenever they run out, so the tree holds
+ * O(M) slots for M flows, and each request takes O(log M) (amortized).
+ */
+class StackDistanceTracker {
+public:
+    static constexpr uint64_t kInfinite = std::numeric_limits<uint64_t>::max();
+
+private:
+    static constexpr size_t kNoSlot = std::numeric_limits<size_t>::max();
+    static constexpr size_t kMinNumSlots = 1024;
+
+    std::vector<uint64_t> tree_; // Fenwick tree of sizes, over slots (1-indexed)
+    std::vector<FlowId> slot_flows_; // Flow last accessed at each slot (or kInvalidFlowId)
+    std::vector<size_t> flow_slots_; // Slot of each flow's last access (or kNoSlot)
+    std::vector<uint64_t> flow_sizes_; // Size of each flow (as first requested)
+    size_t next_slot_ = 0; // Slot of the next access
+    size_t num_flows_ = 0; // Number of flows seen so far
+
+    /**
+     * Internal helper methods. Fenwick tree operations.
+     */
+    void add(size_t slot, const uint64_t delta, const bool is_negative) {
+        for (slot++; slot <= tree_.size(); slot += (slot & -slot)) {
+            if (is_negative) { tree_[slot - 1] -= delta; }
+            else { tree_[slot - 1] += delta; }
+        }
+    }
+    uint64_t prefixSum(size_t num_slots) const {
+        uint64_t sum = 0;
+        for (; num_slots > 0; num_slots -= (num_slots & -num_slots)) {
+            sum += tree_[num_slots - 1];
+        }
+        return sum;
+    }
+
+    /**
+     * Internal helper method. Renumbers the live slots (one per flow)
+     * in access order, resizing the tree to twice the flow count.
+     */
+    void compact() {
+        const size_t num_slots = std::max(kMinNumSlots, 2 * (num_flows_ + 1));
+        std::vector<FlowId> slot_flows;
+        slot_flows.reserve(num_slots);
+        for (size_t slot = 0; slot < next_slot_; slot++) {
+            const FlowId flow_id = slot_flows_[slot];
+            if (flow_id == utils::kInvalidFlowId) { continue; }
+            flow_slots_[flow_id] = slot_flows.size();
+            slot_flows.push_back(flow_id);
+        }
+        next_slot_ = slot_flows.size();
+        slot_flows.resize(num_slots, utils::kInvalidFlowId);
+        slot_flows_.swap(slot_flows);
+
+        // Rebuild the tree in linear time
+        tree_.assign(num_slots, 0);
+        for (size_t idx = 1; idx <= num_slots; idx++) {
+            const FlowId flow_id = slot_flows_[idx - 1];
+            if (flow_id != utils::kInvalidFlowId) { tree_[idx - 1] += flow_sizes_[flow_id]; }
+            const size_t parent = idx + (idx & -idx);
+            if (parent <= num_slots) { tree_[parent - 1] += tree_[idx - 1]; }
+        }
+    }
+
+public:
+    // Accessors
+    uint64_t getFlowSize(const FlowId flow_id) const { return flow_sizes_[flow_id]; }
+    uint64_t getFootprint() const { return prefixSum(next_slot_); }
+
+    /**
+     * Records a request to the given flow, and returns its stack
+     * distance (or kInfinite, if this is the flow's first request).
+     */
+    uint64_t access(const FlowId flow_id, const uint64_t size) {
+        uint64_t distance = kInfinite;
+        if (flow_id >= flow_slots_.size()) {
+            flow_slots_.resize(flow_id + 1, kNoSlot);
+            flow_sizes_.resize(flow_id + 1, 0);
+        }
+        const size_t prev_slot = flow_slots_[flow_id];
+        if (prev_slot == kNoSlot) {
+            flow_sizes_[flow_id] = size;
+            num_flows_++;
+        }
+        else {
+            // Bytes of every flow accessed since, then unlink the flow
+            distance = prefixSum(next_slot_) - prefixSum(prev_slot + 1);
+            add(prev_slot, flow_sizes_[flow_id], true);
+            slot_flows_[prev_slot] = utils::kInvalidFlowId;
+        }
+        if (next_slot_ == slot_flows_.size()) { compact(); }
+
+        // Link the flow at the next slot
+        add(next_slot_, flow_sizes_[flow_id], false);
+        slot_flows_[next_slot_] = flow_id;
+        flow_slots_[flow_id] = next_slot_++;
+        return distance;
+    }
+};
+
+/**
+ * Estimates the delayed-hit latency of an LRU cache of a given size,
+ * under a fixed miss latency.
+ *
+ * A request is taken to hit in the cache if its stack distance is less
+ * than the cache size (i.e., the flow is in the cache, ignoring the
+ * delay before a fetched flow is inserted). A request to a flow whose
+ * fetch is still in flight is a delayed hit, waiting for the remainder
+ * of the fetch; every other request is a miss, and starts a fetch. As
+ * in BaseCache, a fetch takes the miss latency plus the transfer time,
+ * plus a cycle, and completes at the end of the cycle it falls in.
+ */
+class LatencyEstimate {
+private:
+    const uint64_t kCacheSize; // Cache size (in size units)
+    const size_t kMissLatency; // Cost (in cycles) of a cache miss
+    double BWidth = 104857600.0;
+
+    std::vector<double> completion_times_; // Completion time of each flow's last fetch
+    size_t total_latency_ = 0; // Total request latency
+    size_t num_full_hits_ = 0;
+    size_t num_delayed_hits_ = 0;
+    size_t num_misses_ = 0;
+    utils::LatencyHistogram latencies_; // Per-request latencies
+
+public:
+    LatencyEstimate(const uint64_t cache_size, const size_t miss_latency) :
+                    kCacheSize(cache_size), kMissLatency(miss_latency) {}
+
+    // Accessors
+    uint64_t getCacheSize() const { return kCacheSize; }
+    size_t getMissLatency() const { return kMissLatency; }
+    size_t getTotalLatency() const { return total_latency_; }
+    size_t getNumFullHits() const { return num_full_hits_; }
+    size_t getNumDelayedHits() const { return num_delayed_hits_; }
+    size_t getNumMisses() const { return num_misses_; }
+    const utils::LatencyHistogram& getLatencies() const { return latencies_; }
+
+    /**
+     * Records a request to the given flow, issued on the given cycle.
+     */
+    void recordRequest(const FlowId flow_id, const uint64_t size,
+                       const size_t clk, const uint64_t distance) {
+        if (flow_id >= completion_times_.size()) {
+            completion_times_.resize(flow_id + 1, -1);
+        }
+        double& completion_time = completion_times_[flow_id];
+        double latency = 0;
+
+        // Fetches completing before this cycle have been committed
+        if (completion_time > static_cast<double>(clk) - 1) {
+            num_delayed_hits_++;
+            latency = completion_time - clk;
+        }
+        else if (distance < kCacheSize) { num_full_hits_++; }
+        else {
+            num_misses_++;
+            latency = kMissLatency + size * 1000 / (BWidth / 1.0);
+            completion_time = clk + latency + 1;
+        }
+        total_latency_ += latency;
+        latencies_.record(latency);
+    }
+};
+
+/**
+ * Computes the LRU hit-ratio curve of a trace, along with estimated
+ * delayed-hit latencies, in a single pass (see StackDistanceTracker).
+ */
+int main(int argc, char** argv) {
+    using namespace boost::program_options;
+
+    std::string trace_fp;
+    std::string root_fp;
+    std::vector<double> c_scales;
+    std::vector<size_t> zs;
+
+    // Program options
+    variables_map variables;
+    options_description desc{"Computes LRU hit-ratio and latency curves in one pass"};
+
+    try {
+        // Command-line arguments
+        desc.add_options()
+            ("help",        "Prints this message")
+            ("trace",       value<std::string>(&trace_fp)->required(),            "Input trace file path")
+            ("outpath",     value<std::string>(&root_fp)->required(),             "output path")
+            ("csize",       value<std::vector<double>>(&c_scales)->multitoken()->required(), "Parameter: Cache size (%Concurrent Flows); one or more values")
+            ("latency",     value<std::vector<size_t>>(&zs)->multitoken(),        "[Optional] Parameter: u; one or more values, for latency estimates");
+
+        // Parse model parameters
+        store(parse_command_line(argc, argv, desc), variables);
+
+        // Handle help flag
+        if (variables.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        notify(variables);
+    }
+    // Flag argument errors
+    catch(const required_option& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...) {
+        std::cerr << "Unknown Error." << std::endl;
+        return 1;
+    }
+
+    // Cache sizes (in size units), as computed by BaseCache
+    std::vector<uint64_t> cache_sizes;
+    for (const double c_scale : c_scales) {
+        cache_sizes.push_back(std::max<uint64_t>(1, static_cast<uint64_t>(
+            round(c_scale * 1024 * 1024))));
+    }
+    std::vector<LatencyEstimate> estimates;
+    for (const uint64_t cache_size : cache_sizes) {
+        for (const size_t z : zs) { estimates.emplace_back(cache_size, z); }
+    }
+
+    // Hit counts at each requested size, and at every power-of-2
+    // size (a request with distance d hits any cache larger than d).
+    std::vector<size_t> num_hits(cache_sizes.size(), 0);
+    std::vector<size_t> log2_distances(65, 0); // Requests, by bit width of distance
+    size_t num_requests = 0;
+
+    utils::TraceReader reader(trace_fp);
+    utils::TraceRecord record;
+    utils::FlowIdTable flow_ids;
+    StackDistanceTracker tracker;
+
+    for (size_t clk = 0; reader.next(record); clk++) {
+        if (record.flow_id.empty()) { continue; }
+        const FlowId flow_id = flow_ids.intern(record.flow_id);
+        const uint64_t distance = tracker.access(flow_id, record.flow_size);
+        num_requests++;
+
+        if (distance != StackDistanceTracker::kInfinite) {
+            size_t width = 0;
+            for (uint64_t value = distance; value > 0; value >>= 1) { width++; }
+            log2_distances[width]++;
+
+            for (size_t idx = 0; idx < cache_sizes.size(); idx++) {
+                if (distance < cache_sizes[idx]) { num_hits[idx]++; }
+            }
+        }
+        for (LatencyEstimate& estimate : estimates) {
+            estimate.recordRequest(flow_id, record.flow_size, clk, distance);
+        }
+    }
+    const double denominator = std::max<size_t>(1, num_requests);
+
+    // Records all Results into a File
+    std::ofstream WFile(root_fp + "LRUMRC.txt");
+    if (!WFile) {
+        std::cerr << "Error: Could not open " << root_fp << "LRUMRC.txt" << std::endl;
+        return 1;
+    }
+    WFile << "Requests:" << num_requests << std::endl;
+    WFile << "Flows:" << flow_ids.size() << std::endl;
+    WFile << "Footprint:" << tracker.getFootprint() << std::endl;
+
+    WFile << "Hit ratio (csize;entries;hit_ratio):" << std::endl;
+    for (size_t idx = 0; idx < cache_sizes.size(); idx++) {
+        WFile << c_scales[idx] << ";" << cache_sizes[idx] << ";"
+              << (num_hits[idx] / denominator) << std::endl;
+    }
+    WFile << "Hit ratio curve (entries;hit_ratio):" << std::endl;
+    size_t cumulative_hits = 0;
+    for (size_t width = 0; width < 64; width++) {
+        // Distances below 2^width have a bit width of at most width
+        cumulative_hits += log2_distances[width];
+        const uint64_t entries = (uint64_t(1) << width);
+        WFile << entries << ";" << (cumulative_hits / denominator) << std::endl;
+        if (entries > tracker.getFootprint()) { break; }
+    }
+    if (!estimates.empty()) {
+        WFile << "Estimated latency (entries;latency;total_latency;full_hits;"
+              << "delayed_hits;misses;count;mean;p50;p90;p99;p99.9;max):" << std::endl;
+        for (const LatencyEstimate& estimate : estimates) {
+            WFile << estimate.getCacheSize() << ";" << estimate.getMissLatency() << ";"
+                  << estimate.getTotalLatency() << ";" << estimate.getNumFullHits() << ";"
+                  << estimate.getNumDelayedHits() << ";" << estimate.getNumMisses() << ";"
+                  << estimate.getLatencies().getSummary() << std::endl;
+        }
+    }
+    WFile.close();
+
+    std::cout << "Requests: " << num_requests << ", flows: " << flow_ids.size()
+              << ", footprint: " << tracker.getFootprint() << std::endl;
+    for (size_t idx = 0; idx < cache_sizes.size(); idx++) {
+        std::cout << "c=" << c_scales[idx] << ": hit ratio "
+                  << (num_hits[idx] / denominator) << std::endl;
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 // STD headers
 #include <assert.h>
 #include <list>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -11,6 +12,7 @@
 #include "utils.hpp"
 
 using namespace caching;
+namespace bopt = boost::program_options;
 
 /**
  * Represents a single set (row) in an LRU-based cache.
@@ -21,17 +23,18 @@ protected:
     TQQueue<CacheEntry> History;
 
 public:
-    std::unordered_map<std::string,uint64_t> Freqs;//用于记录未被cache的item对应的访问频率
+    std::unordered_map<FlowId, uint64_t> Freqs;//用于记录未被cache的item对应的访问频率
 
-    LRUKCacheSet(const size_t num_entries, const size_t misslat) : BaseCacheSet(num_entries,misslat) {}
+    LRUKCacheSet(const size_t num_entries, const size_t misslat, const size_t k) :
+                 BaseCacheSet(num_entries,misslat) {queue_.setK(k);}
     virtual ~LRUKCacheSet() {}
 
-    std::unordered_map<std::string,uint64_t> Sizes1;
+    std::unordered_map<FlowId, uint64_t> Sizes1;
     uint64_t UsedSpace = 0;
     uint64_t HisSpace = 0;
     
     virtual int
-    update_freqs(const std::string& key, uint64_t size){
+    update_freqs(const FlowId key, uint64_t size){
         if(Sizes1.find(key) == Sizes1.end()){
            Sizes1[key] = size;
            queue_.Sizes2[key] = size;
@@ -48,7 +51,7 @@ public:
             CacheEntry evicted_entry;
             auto position_iter = History.positions().find(key);
             if (position_iter != History.positions().end()) {
-                written_entry = *(position_iter->second);
+                written_entry = History.entries()[position_iter->second];
                 History.erase(position_iter);
             }
             else{
@@ -76,7 +79,7 @@ public:
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    write(const std::string& key, const utils::Packet& packet) override {
+    write(const FlowId key, const utils::Packet& packet) override {
         SUPPRESS_UNUSED_WARNING(packet);
         CacheEntry written_entry;
         CacheEntry evicted_entry;
@@ -101,7 +104,7 @@ public:
             written_entry.update(key);
             written_entry.toggleValid();
 
-            if(History.HisFreqs[key] >= 4){
+            if(History.HisFreqs[key] >= queue_.K){
                 queue_.insertBack(written_entry); 
                 // Update the occupied entries set
                 occupied_entries_set_.insert(key);
@@ -131,13 +134,12 @@ public:
      * on every queued packet; this simply presents an optimization opportunity
      * for policies which do not distinguish between single/multiple writes.
      *
-     * @param queue The queued write requests.
+     * @param read The completed read, holding the queued write requests.
      * @return The written CacheEntry instance.
      */
     virtual CacheEntry
-    writeq(const std::list<utils::Packet>& queue) override {
-        const utils::Packet& packet = queue.back();
-        return write(packet.getFlowId(), packet);
+    writeq(const InFlightRead& read) override {
+        return write(read.getFlowId(), read.getPacket());
     }
 };
 
@@ -150,12 +152,22 @@ public:
              num_cache_sets, const bool penalize_insertions, const HashType hash_type, int
              argc, char** argv) : BaseCache(miss_latency, cache_set_associativity,
              num_cache_sets, penalize_insertions, hash_type) {
-        SUPPRESS_UNUSED_WARNING(argc);
-        SUPPRESS_UNUSED_WARNING(argv);
+        // Command-line arguments
+        bopt::options_description options{"LRUKCache"};
+        options.add_options()("k", bopt::value<size_t>()->default_value(4), "Parameter: K");
+
+        // Parse model parameters
+        bopt::variables_map variables;
+        bopt::store(bopt::command_line_parser(argc, argv).options(
+            options).allow_unregistered().run(), variables);
+
+        bopt::notify(variables);
+        const size_t k = variables.at("k").as<size_t>();
+        if (k == 0) { throw std::invalid_argument("K must be positive."); }
 
         // Initialize the cache sets
         for (size_t idx = 0; idx < kMaxNumCacheSets; idx++) {
-            cache_sets_.push_back(new LRUKCacheSet(kCacheSetAssociativity,miss_latency));
+            cache_sets_.push_back(new LRUKCacheSet(kCacheSetAssociativity,miss_latency,k));
         }
     }
     virtual ~LRUKCache() {}
@@ -164,6 +176,11 @@ public:
      * Returns the canonical cache name.
      */
     virtual std::string name() const override { return "LRUKCache"; }
+
+    /**
+     * The cache sets share no policy state.
+     */
+    virtual bool hasIndependentSets() const override { return true; }
 };
 
 // Run default benchmarks
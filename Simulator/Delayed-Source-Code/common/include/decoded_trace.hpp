@@ -0,0 +1,63 @@
+#ifndef decoded_trace_hpp
+#define decoded_trace_hpp
+
+// STD headers
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Custom headers
+#include "trace_reader.hpp"
+#include "utils.hpp"
+
+namespace utils {
+
+/**
+ * A single decoded trace record.
+ */
+struct DecodedRecord {
+    FlowId flow_id; // kInvalidFlowId for idle cycles
+    uint64_t flow_size;
+};
+
+/**
+ * Represents a fully-decoded trace, held in memory.
+ *
+ * The trace is parsed exactly once, and its flow IDs are interned (in
+ * order of first appearance, as during a streaming run) into a table
+ * owned by the trace. Once constructed, the trace is immutable, so a
+ * single instance may be replayed by any number of concurrent runs.
+ */
+class DecodedTrace {
+private:
+    std::vector<DecodedRecord> records_; // Records, in trace order
+    FlowIdTable flow_ids_; // Interned flow IDs
+
+public:
+    explicit DecodedTrace(const std::string& trace_fp) {
+        TraceReader reader(trace_fp);
+        TraceRecord record;
+        if (reader.isBinary()) { records_.reserve(reader.getNumRecords()); }
+
+        while (reader.next(record)) {
+            if (record.flow_id.empty()) {
+                records_.push_back(DecodedRecord{kInvalidFlowId, 1});
+            }
+            else {
+                records_.push_back(DecodedRecord{flow_ids_.intern(
+                    record.flow_id), record.flow_size});
+            }
+        }
+    }
+    DecodedTrace(const DecodedTrace&) = delete;
+    DecodedTrace& operator=(const DecodedTrace&) = delete;
+
+    // Accessors
+    size_t size() const { return records_.size(); }
+    const DecodedRecord& operator[](const size_t idx) const { return records_[idx]; }
+    const FlowIdTable& getFlowIds() const { return flow_ids_; }
+};
+
+} // namespace utils
+
+#endif // decoded_trace_hpp
@@ -0,0 +1,386 @@
+#ifndef flat_hash_map_hpp
+#define flat_hash_map_hpp
+
+// STD headers
+#include <algorithm>
+#include <assert.h>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace utils {
+
+/**
+ * Implements an open-addressing hash map (Robin Hood hashing).
+ *
+ * Entries are stored in a single flat array, alongside an array
+ * holding each slot's probe distance (0 marks an empty slot). Lookups
+ * probe linearly from the key's home slot, and stop as soon as they
+ * reach a slot whose entry is closer to its own home than the key
+ * would be. Deletion shifts the following entries back by one slot
+ * instead of leaving tombstones, so probe sequences never degrade.
+ * Home slots are picked by Fibonacci hashing on the high bits of the
+ * hash, so identity hashes (e.g., of dense FlowIds) spread evenly.
+ *
+ * Unlike std::unordered_map, entries are stored inline: insertions and
+ * erasures invalidate every iterator and reference into the map. The
+ * key is exposed as a mutable pair member, but must not be modified.
+ */
+template<class Key, class Value, class Hash=std::hash<Key>,
+         class KeyEqual=std::equal_to<Key>>
+class FlatHashMap {
+public:
+    typedef std::pair<Key, Value> value_type;
+
+private:
+    typedef std::allocator<value_type> Allocator;
+    typedef std::allocator_traits<Allocator> AllocatorTraits;
+
+    static constexpr size_t kMinCapacity = 8;
+
+    value_type* slots_ = nullptr; // Entries (only slots with distances_ > 0 are constructed)
+    uint32_t* distances_ = nullptr; // Probe distance + 1 of each slot's entry, or 0 (empty)
+    size_t capacity_ = 0; // Number of slots (0, or a power of two)
+    size_t size_ = 0; // Number of entries
+    uint32_t shift_ = 64; // (64 - log2(capacity)), for Fibonacci hashing
+    Allocator allocator_;
+    Hash hash_;
+    KeyEqual equal_;
+
+    /**
+     * Internal helper method. Returns the home slot of the given key.
+     */
+    size_t getHomeSlot(const Key& key) const {
+        return static_cast<size_t>((static_cast<uint64_t>(hash_(key)) *
+                                    UINT64_C(0x9E3779B97F4A7C15)) >> shift_);
+    }
+
+    /**
+     * Internal helper method. Returns the slot holding the given key,
+     * or capacity_ if the key does not exist.
+     */
+    size_t findSlot(const Key& key) const {
+        if (size_ == 0) { return capacity_; }
+        const size_t mask = (capacity_ - 1);
+        size_t idx = getHomeSlot(key);
+        for (uint32_t distance = 1; distances_[idx] >= distance; distance++) {
+            if (distances_[idx] == distance && equal_(slots_[idx].first, key)) {
+                return idx;
+            }
+            idx = (idx + 1) & mask;
+        }
+        return capacity_;
+    }
+
+    /**
+     * Internal helper method. Inserts the given entry (whose key must not
+     * exist), and returns its slot.
+     */
+    size_t insertNew(value_type&& entry) {
+        if (capacity_ == 0 || (size_ + 1) * 5 > capacity_ * 4) {
+            rehash(capacity_ == 0 ? kMinCapacity : capacity_ * 2);
+        }
+        const size_t mask = (capacity_ - 1);
+        size_t idx = getHomeSlot(entry.first);
+        size_t inserted_idx = capacity_;
+        uint32_t distance = 1;
+        while (true) {
+            if (distances_[idx] == 0) {
+                AllocatorTraits::construct(allocator_, &slots_[idx], std::move(entry));
+                distances_[idx] = distance;
+                size_++;
+                return (inserted_idx == capacity_) ? idx : inserted_idx;
+            }
+            // Robin Hood: take the slot of any entry closer to its home
+            if (distances_[idx] < distance) {
+                std::swap(entry, slots_[idx]);
+                std::swap(distance, distances_[idx]);
+                if (inserted_idx == capacity_) { inserted_idx = idx; }
+            }
+            idx = (idx + 1) & mask;
+            distance++;
+        }
+    }
+
+    /**
+     * Internal helper method. Erases the entry at the given slot,
+     * shifting any displaced entries that follow it back by one.
+     */
+    void eraseSlot(size_t idx) {
+        const size_t mask = (capacity_ - 1);
+        AllocatorTraits::destroy(allocator_, &slots_[idx]);
+        size_t next = (idx + 1) & mask;
+        while (distances_[next] > 1) {
+            AllocatorTraits::construct(allocator_, &slots_[idx], std::move(slots_[next]));
+            AllocatorTraits::destroy(allocator_, &slots_[next]);
+            distances_[idx] = distances_[next] - 1;
+            idx = next;
+            next = (next + 1) & mask;
+        }
+        distances_[idx] = 0;
+        size_--;
+    }
+
+    /**
+     * Internal helper method. Moves every entry into a new slot array.
+     */
+    void rehash(const size_t capacity) {
+        value_type* old_slots = slots_;
+        uint32_t* old_distances = distances_;
+        const size_t old_capacity = capacity_;
+
+        slots_ = AllocatorTraits::allocate(allocator_, capacity);
+        distances_ = new uint32_t[capacity]();
+        capacity_ = capacity;
+        shift_ = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) { shift_--; }
+        size_ = 0;
+
+        for (size_t idx = 0; idx < old_capacity; idx++) {
+            if (old_distances[idx] != 0) {
+                insertNew(std::move(old_slots[idx]));
+                AllocatorTraits::destroy(allocator_, &old_slots[idx]);
+            }
+        }
+        deallocate(old_slots, old_distances, old_capacity);
+    }
+
+    /**
+     * Internal helper method. Destroys every entry, and releases the slots.
+     */
+    void release() {
+        for (size_t idx = 0; idx < capacity_; idx++) {
+            if (distances_[idx] != 0) { AllocatorTraits::destroy(allocator_, &slots_[idx]); }
+        }
+        deallocate(slots_, distances_, capacity_);
+        slots_ = nullptr;
+        distances_ = nullptr;
+        capacity_ = 0;
+        size_ = 0;
+        shift_ = 64;
+    }
+    void deallocate(value_type* slots, uint32_t* distances, const size_t capacity) {
+        if (slots != nullptr) { AllocatorTraits::deallocate(allocator_, slots, capacity); }
+        delete[] distances;
+    }
+
+    /**
+     * Iterator over the occupied slots, in slot order.
+     */
+    template<bool IsConst>
+    class Iterator {
+    private:
+        friend class FlatHashMap;
+        template<bool> friend class Iterator;
+        typedef typename std::conditional<IsConst, const FlatHashMap*, FlatHashMap*>::type Map;
+        Map map_ = nullptr;
+        size_t idx_ = 0;
+
+        Iterator(Map map, const size_t idx) : map_(map), idx_(idx) { skipEmpty(); }
+        void skipEmpty() {
+            while (idx_ < map_->capacity_ && map_->distances_[idx_] == 0) { idx_++; }
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename FlatHashMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<IsConst, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<IsConst, const value_type&, value_type&>::type reference;
+
+        Iterator() = default;
+        template<bool OtherConst, class = typename std::enable_if<IsConst && !OtherConst>::type>
+        Iterator(const Iterator<OtherConst>& other) : map_(other.map_), idx_(other.idx_) {}
+
+        reference operator*() const { return map_->slots_[idx_]; }
+        pointer operator->() const { return &map_->slots_[idx_]; }
+        Iterator& operator++() { idx_++; skipEmpty(); return *this; }
+        Iterator operator++(int) { Iterator copy(*this); ++(*this); return copy; }
+        bool operator==(const Iterator& other) const { return idx_ == other.idx_; }
+        bool operator!=(const Iterator& other) const { return idx_ != other.idx_; }
+    };
+
+public:
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    FlatHashMap() = default;
+    FlatHashMap(const FlatHashMap& other) { *this = other; }
+    FlatHashMap(FlatHashMap&& other) noexcept { *this = std::move(other); }
+    ~FlatHashMap() { release(); }
+
+    FlatHashMap& operator=(const FlatHashMap& other) {
+        if (this == &other) { return *this; }
+        release();
+        if (other.capacity_ > 0) {
+            slots_ = AllocatorTraits::allocate(allocator_, other.capacity_);
+            distances_ = new uint32_t[other.capacity_]();
+            capacity_ = other.capacity_;
+            shift_ = other.shift_;
+            for (size_t idx = 0; idx < capacity_; idx++) {
+                if (other.distances_[idx] != 0) {
+                    AllocatorTraits::construct(allocator_, &slots_[idx], other.slots_[idx]);
+                    distances_[idx] = other.distances_[idx];
+                }
+            }
+            size_ = other.size_;
+        }
+        return *this;
+    }
+    FlatHashMap& operator=(FlatHashMap&& other) noexcept {
+        if (this == &other) { return *this; }
+        release();
+        std::swap(slots_, other.slots_);
+        std::swap(distances_, other.distances_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        std::swap(shift_, other.shift_);
+        return *this;
+    }
+
+    // Accessors
+    bool empty() const { return (size_ == 0); }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+
+    // Iterators
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, capacity_); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, capacity_); }
+
+    /**
+     * Lookup.
+     */
+    iterator find(const Key& key) { return iterator(this, findSlot(key)); }
+    const_iterator find(const Key& key) const { return const_iterator(this, findSlot(key)); }
+    size_t count(const Key& key) const { return (findSlot(key) != capacity_) ? 1 : 0; }
+    bool contains(const Key& key) const { return (findSlot(key) != capacity_); }
+
+    Value& at(const Key& key) {
+        const size_t idx = findSlot(key);
+        if (idx == capacity_) { throw std::out_of_range("FlatHashMap::at"); }
+        return slots_[idx].second;
+    }
+    const Value& at(const Key& key) const {
+        const size_t idx = findSlot(key);
+        if (idx == capacity_) { throw std::out_of_range("FlatHashMap::at"); }
+        return slots_[idx].second;
+    }
+
+    /**
+     * Returns the value for the given key, inserting
+     * a default-constructed value if it does not exist.
+     */
+    Value& operator[](const Key& key) {
+        const size_t idx = findSlot(key);
+        if (idx != capacity_) { return slots_[idx].second; }
+        const size_t inserted_idx = insertNew(value_type(key, Value()));
+        return slots_[inserted_idx].second;
+    }
+
+    /**
+     * Inserts the given entry if its key does not exist. Returns an
+     * iterator to the entry with this key, and whether it was inserted.
+     */
+    template<class... Args>
+    std::pair<iterator, bool> emplace(const Key& key, Args&&... args) {
+        const size_t idx = findSlot(key);
+        if (idx != capacity_) { return std::make_pair(iterator(this, idx), false); }
+        const size_t inserted_idx = insertNew(value_type(std::piecewise_construct,
+            std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...)));
+        return std::make_pair(iterator(this, inserted_idx), true);
+    }
+    std::pair<iterator, bool> insert(const value_type& entry) {
+        return emplace(entry.first, entry.second);
+    }
+
+    /**
+     * Erases the given entry (or key, returning the number of erased entries).
+     */
+    void erase(const_iterator position) {
+        assert(position.idx_ < capacity_ && distances_[position.idx_] != 0);
+        eraseSlot(position.idx_);
+    }
+    size_t erase(const Key& key) {
+        const size_t idx = findSlot(key);
+        if (idx == capacity_) { return 0; }
+        eraseSlot(idx);
+        return 1;
+    }
+
+    /**
+     * Erases every entry (retaining the allocated slots).
+     */
+    void clear() {
+        for (size_t idx = 0; idx < capacity_; idx++) {
+            if (distances_[idx] != 0) {
+                AllocatorTraits::destroy(allocator_, &slots_[idx]);
+                distances_[idx] = 0;
+            }
+        }
+        size_ = 0;
+    }
+
+    /**
+     * Grows the map (if required) to hold the given number of entries.
+     */
+    void reserve(const size_t num_entries) {
+        size_t capacity = std::max(capacity_, kMinCapacity);
+        while (num_entries * 5 > capacity * 4) { capacity *= 2; }
+        if (capacity != capacity_) { rehash(capacity); }
+    }
+};
+
+/**
+ * Implements an open-addressing hash set (see FlatHashMap).
+ */
+template<class Key, class Hash=std::hash<Key>, class KeyEqual=std::equal_to<Key>>
+class FlatHashSet {
+private:
+    struct Empty {};
+    FlatHashMap<Key, Empty, Hash, KeyEqual> map_; // Keys (with empty values)
+
+public:
+    // Accessors
+    bool empty() const { return map_.empty(); }
+    size_t size() const { return map_.size(); }
+
+    /**
+     * Membership test.
+     */
+    size_t count(const Key& key) const { return map_.count(key); }
+    bool contains(const Key& key) const { return map_.contains(key); }
+
+    /**
+     * Inserts the given key. Returns whether it was inserted.
+     */
+    bool insert(const Key& key) { return map_.emplace(key).second; }
+
+    /**
+     * Erases the given key. Returns the number of erased keys.
+     */
+    size_t erase(const Key& key) { return map_.erase(key); }
+
+    /**
+     * Erases every key.
+     */
+    void clear() { map_.clear(); }
+
+    /**
+     * Invokes the given function on every key.
+     */
+    template<class Function>
+    void forEach(Function function) const {
+        for (const auto& entry : map_) { function(entry.first); }
+    }
+};
+
+} // namespace utils
+
+#endif // flat_hash_map_hpp
@@ -0,0 +1,153 @@
+#ifndef indexed_heap_hpp
+#define indexed_heap_hpp
+
+// STD headers
+#include <assert.h>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Custom headers
+#include "utils.hpp"
+
+namespace utils {
+
+/**
+ * Implements an indexed binary heap over dense FlowId handles.
+ *
+ * Each key appears at most once, and its position in the heap is
+ * tracked in a flat array indexed by FlowId, so that the priority of
+ * any key can be updated (or the key removed) in O(log n). The top of
+ * the heap is the key whose priority is smallest under Compare (i.e.,
+ * this is a min-heap for the default std::less).
+ */
+template<class Priority, class Compare=std::less<Priority>>
+class IndexedHeap {
+private:
+    static constexpr size_t kNotInHeap = SIZE_MAX;
+
+    std::vector<std::pair<Priority, FlowId>> heap_; // Binary heap of (priority, key)
+    std::vector<size_t> positions_; // Heap index of each key, or kNotInHeap
+    Compare compare_; // Priority comparator
+
+    /**
+     * Internal helper method. Whether the entry at idx a should be above b.
+     */
+    bool isAbove(const size_t a, const size_t b) const {
+        return compare_(heap_[a].first, heap_[b].first);
+    }
+
+    /**
+     * Internal helper method. Swaps two heap entries.
+     */
+    void swapEntries(const size_t a, const size_t b) {
+        std::swap(heap_[a], heap_[b]);
+        positions_[heap_[a].second] = a;
+        positions_[heap_[b].second] = b;
+    }
+
+    /**
+     * Internal helper method. Restores the heap property, starting at idx.
+     */
+    void siftUp(size_t idx) {
+        while (idx > 0) {
+            const size_t parent = (idx - 1) / 2;
+            if (!isAbove(idx, parent)) { break; }
+            swapEntries(idx, parent);
+            idx = parent;
+        }
+    }
+    void siftDown(size_t idx) {
+        while (true) {
+            const size_t left = (2 * idx) + 1;
+            const size_t right = left + 1;
+            size_t best = idx;
+            if (left < heap_.size() && isAbove(left, best)) { best = left; }
+            if (right < heap_.size() && isAbove(right, best)) { best = right; }
+            if (best == idx) { break; }
+            swapEntries(idx, best);
+            idx = best;
+        }
+    }
+
+public:
+    // Accessors
+    bool empty() const { return heap_.empty(); }
+    size_t size() const { return heap_.size(); }
+    bool contains(const FlowId key) const {
+        return (key < positions_.size() && positions_[key] != kNotInHeap);
+    }
+    const Priority& priority(const FlowId key) const {
+        assert(contains(key));
+        return heap_[positions_[key]].first;
+    }
+    /**
+     * Returns the (priority, key) pair at the top of the heap.
+     */
+    const std::pair<Priority, FlowId>& top() const {
+        assert(!empty());
+        return heap_.front();
+    }
+
+    /**
+     * Inserts the given key, or updates its priority if it already exists.
+     */
+    void push(const FlowId key, const Priority& priority) {
+        if (contains(key)) { update(key, priority); return; }
+        if (key >= positions_.size()) {
+            positions_.resize(key + 1, kNotInHeap);
+        }
+        positions_[key] = heap_.size();
+        heap_.emplace_back(priority, key);
+        siftUp(heap_.size() - 1);
+    }
+
+    /**
+     * Updates the priority of an existing key.
+     */
+    void update(const FlowId key, const Priority& priority) {
+        assert(contains(key));
+        heap_[positions_[key]].first = priority;
+        siftUp(positions_[key]);
+        siftDown(positions_[key]);
+    }
+
+    /**
+     * Removes the given key (if it exists).
+     */
+    void erase(const FlowId key) {
+        if (!contains(key)) { return; }
+        const size_t idx = positions_[key];
+        swapEntries(idx, heap_.size() - 1);
+        heap_.pop_back();
+        positions_[key] = kNotInHeap;
+
+        // Restore the heap property for the entry that was moved into idx
+        if (idx < heap_.size()) {
+            const FlowId moved_key = heap_[idx].second;
+            siftUp(idx);
+            siftDown(positions_[moved_key]);
+        }
+    }
+
+    /**
+     * Removes and returns the key at the top of the heap.
+     */
+    FlowId pop() {
+        const FlowId key = top().second;
+        erase(key);
+        return key;
+    }
+
+    /**
+     * Removes every key.
+     */
+    void clear() {
+        heap_.clear();
+        positions_.clear();
+    }
+};
+
+} // namespace utils
+
+#endif // indexed_heap_hpp
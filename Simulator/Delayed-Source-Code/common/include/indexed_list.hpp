@@ -0,0 +1,123 @@
+#ifndef indexed_list_hpp
+#define indexed_list_hpp
+
+// STD headers
+#include <assert.h>
+#include <cstdint>
+#include <vector>
+
+namespace utils {
+
+/**
+ * Implements a doubly linked list over a contiguous slot array.
+ *
+ * Each node lives in a slot of a single vector, and is linked to its
+ * neighbours by 32-bit slot indices rather than pointers. The slots of
+ * erased nodes are threaded onto a free list, and reused by subsequent
+ * insertions, so that (once the list has reached its peak size) no
+ * operation allocates. Slot indices remain valid until the node that
+ * occupies them is erased.
+ */
+template<class T>
+class IndexedList {
+public:
+    typedef uint32_t Index;
+    static constexpr Index kNull = UINT32_MAX;
+
+private:
+    struct Node {
+        T value;
+        Index prev = kNull; // Previous node (or kNull)
+        Index next = kNull; // Next node (or, if free, the next free slot)
+    };
+    std::vector<Node> nodes_; // Node slots
+    Index head_ = kNull; // First node
+    Index tail_ = kNull; // Last node
+    Index free_ = kNull; // First free slot
+    size_t size_ = 0; // Number of nodes
+
+    /**
+     * Internal helper methods. Link (or unlink) the node at
+     * the given index at the back of (or from) the list.
+     */
+    void linkBack(const Index idx) {
+        nodes_[idx].prev = tail_;
+        nodes_[idx].next = kNull;
+        if (tail_ != kNull) { nodes_[tail_].next = idx; }
+        else { head_ = idx; }
+        tail_ = idx;
+    }
+    void unlink(const Index idx) {
+        const Node& node = nodes_[idx];
+        if (node.prev != kNull) { nodes_[node.prev].next = node.next; }
+        else { head_ = node.next; }
+        if (node.next != kNull) { nodes_[node.next].prev = node.prev; }
+        else { tail_ = node.prev; }
+    }
+
+public:
+    // Accessors
+    bool empty() const { return (size_ == 0); }
+    size_t size() const { return size_; }
+    Index front() const { return head_; }
+    Index back() const { return tail_; }
+    Index next(const Index idx) const { return nodes_[idx].next; }
+    Index prev(const Index idx) const { return nodes_[idx].prev; }
+
+    T& operator[](const Index idx) { return nodes_[idx].value; }
+    const T& operator[](const Index idx) const { return nodes_[idx].value; }
+
+    /**
+     * Inserts the given value at the back of the list,
+     * and returns the index of its node.
+     */
+    Index pushBack(const T& value) {
+        Index idx = free_;
+        if (idx != kNull) {
+            free_ = nodes_[idx].next;
+            nodes_[idx].value = value;
+        }
+        else {
+            assert(nodes_.size() < kNull);
+            idx = static_cast<Index>(nodes_.size());
+            nodes_.push_back(Node{value, kNull, kNull});
+        }
+        linkBack(idx);
+        size_++;
+        return idx;
+    }
+
+    /**
+     * Erases the node at the given index, and frees its slot.
+     */
+    void erase(const Index idx) {
+        assert(idx < nodes_.size() && size_ > 0);
+        unlink(idx);
+        nodes_[idx].prev = kNull;
+        nodes_[idx].next = free_;
+        free_ = idx;
+        size_--;
+    }
+
+    /**
+     * Moves the node at the given index to the back of the list.
+     */
+    void moveToBack(const Index idx) {
+        if (idx == tail_) { return; }
+        unlink(idx);
+        linkBack(idx);
+    }
+
+    /**
+     * Erases every node (retaining the allocated slots).
+     */
+    void clear() {
+        nodes_.clear();
+        head_ = tail_ = free_ = kNull;
+        size_ = 0;
+    }
+};
+
+} // namespace utils
+
+#endif // indexed_list_hpp
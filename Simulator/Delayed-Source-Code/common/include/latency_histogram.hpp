@@ -0,0 +1,122 @@
+#ifndef latency_histogram_hpp
+#define latency_histogram_hpp
+
+// STD headers
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace utils {
+
+/**
+ * Implements a fixed-size, log-bucketed latency histogram.
+ *
+ * Values below kSubBuckets are counted exactly. Larger values are
+ * bucketed by their power of two, with each power of two split into
+ * kSubBuckets linear sub-buckets, so any reported percentile is within
+ * 1/kSubBuckets (~3%) of the true value. The mean and maximum are
+ * tracked exactly.
+ */
+class LatencyHistogram {
+private:
+    static constexpr unsigned kSubBucketBits = 5;
+    static constexpr size_t kSubBuckets = (1 << kSubBucketBits);
+    static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    std::array<uint64_t, kNumBuckets> counts_{}; // Per-bucket counts
+    uint64_t num_samples_ = 0; // Total sample count
+    double sum_ = 0; // Sum of all samples
+    uint64_t max_ = 0; // Largest sample
+
+    /**
+     * Internal helper method. Returns the bucket index for the given value.
+     */
+    static size_t getBucketIdx(const uint64_t value) {
+        if (value < kSubBuckets) { return value; }
+        const unsigned log2 = 63 - __builtin_clzll(value);
+        const unsigned shift = log2 - kSubBucketBits;
+        return ((log2 - kSubBucketBits + 1) * kSubBuckets) +
+               ((value >> shift) - kSubBuckets);
+    }
+
+    /**
+     * Internal helper method. Returns the largest value in the given bucket.
+     */
+    static uint64_t getBucketUpperBound(const size_t idx) {
+        if (idx < kSubBuckets) { return idx; }
+        const unsigned shift = (idx / kSubBuckets) - 1;
+        const uint64_t mantissa = kSubBuckets + (idx % kSubBuckets);
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+public:
+    // Accessors
+    uint64_t getNumSamples() const { return num_samples_; }
+    uint64_t getMax() const { return max_; }
+    double getSum() const { return sum_; }
+    double getMean() const {
+        return (num_samples_ == 0) ? 0 : (sum_ / num_samples_);
+    }
+
+    /**
+     * Records a single latency sample. The sum uses the exact value;
+     * the bucket uses its integer part.
+     */
+    void record(const double latency) {
+        const uint64_t value = static_cast<uint64_t>(latency);
+        counts_[getBucketIdx(value)]++;
+        num_samples_++;
+        sum_ += latency;
+        max_ = std::max(max_, value);
+    }
+
+    /**
+     * Adds the samples of another histogram to this one.
+     */
+    void merge(const LatencyHistogram& other) {
+        for (size_t idx = 0; idx < kNumBuckets; idx++) {
+            counts_[idx] += other.counts_[idx];
+        }
+        num_samples_ += other.num_samples_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    /**
+     * Returns the q'th quantile (0 < q <= 1), reported as the upper
+     * bound of the containing bucket (clamped to the maximum).
+     */
+    uint64_t getPercentile(const double q) const {
+        if (num_samples_ == 0) { return 0; }
+        uint64_t rank = static_cast<uint64_t>(q * num_samples_);
+        if (rank < q * num_samples_) { rank++; }
+        rank = std::max<uint64_t>(rank, 1);
+
+        uint64_t seen = 0;
+        for (size_t idx = 0; idx < kNumBuckets; idx++) {
+            seen += counts_[idx];
+            if (seen >= rank) {
+                return std::min(getBucketUpperBound(idx), max_);
+            }
+        }
+        return max_;
+    }
+
+    /**
+     * Returns a one-line summary: "count;mean;p50;p90;p99;p99.9;max".
+     */
+    std::string getSummary() const {
+        return (std::to_string(num_samples_) + ";" +
+                std::to_string(getMean()) + ";" +
+                std::to_string(getPercentile(0.5)) + ";" +
+                std::to_string(getPercentile(0.9)) + ";" +
+                std::to_string(getPercentile(0.99)) + ";" +
+                std::to_string(getPercentile(0.999)) + ";" +
+                std::to_string(max_));
+    }
+};
+
+} // namespace utils
+
+#endif // latency_histogram_hpp
@@ -0,0 +1,104 @@
+#ifndef pipelined_trace_reader_hpp
+#define pipelined_trace_reader_hpp
+
+// STD headers
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Custom headers
+#include "flat_hash_map.hpp"
+#include "spsc_ring.hpp"
+#include "trace_reader.hpp"
+#include "utils.hpp"
+
+namespace utils {
+
+/**
+ * A single record decoded by a PipelinedTraceReader.
+ */
+struct PipelinedRecord {
+    FlowId flow_id = kInvalidFlowId; // kInvalidFlowId for idle cycles
+    uint64_t flow_size = 1;
+    std::string_view name; // Flow name; only set on the flow's first appearance
+};
+
+/**
+ * Implements a trace reader which decodes on a producer thread.
+ *
+ * The producer scans the mapped trace, parses every record, and assigns
+ * dense flow IDs (in order of first appearance, as FlowIdTable would),
+ * feeding the results to the caller through an SPSCRing. The caller's
+ * thread only consumes records; it must intern each new flow's name
+ * (i.e., whenever name is non-empty) to keep its own table in step.
+ * Names are views into the mapped trace, valid while the reader lives.
+ */
+class PipelinedTraceReader {
+private:
+    static constexpr size_t kRingCapacity = (1 << 16); // Records in flight
+    static constexpr size_t kBatchSize = 1024; // Records per batch
+
+    TraceReader reader_; // Underlying trace reader (producer-only)
+    SPSCRing<PipelinedRecord> ring_; // Decoded records
+    std::exception_ptr error_; // Producer-side error (if any)
+    std::thread producer_; // Producer thread
+
+    /**
+     * Internal helper method. The producer thread's main loop.
+     */
+    void produce() {
+        try {
+            FlatHashMap<std::string_view, FlowId> ids; // Assigned flow IDs
+            TraceRecord record;
+            while (reader_.next(record)) {
+                PipelinedRecord decoded;
+                if (!record.flow_id.empty()) {
+                    if (ids.size() >= kInvalidFlowId) { throw std::runtime_error(
+                        "Too many flows for 32-bit flow IDs.");
+                    }
+                    const auto result = ids.emplace(record.flow_id,
+                                                    static_cast<FlowId>(ids.size()));
+                    decoded.flow_id = result.first->second;
+                    decoded.flow_size = record.flow_size;
+                    if (result.second) { decoded.name = record.flow_id; }
+                }
+                if (!ring_.push(decoded)) { return; } // Closed by the consumer
+            }
+        }
+        catch (...) { error_ = std::current_exception(); }
+
+        ring_.flush();
+        ring_.close();
+    }
+
+public:
+    explicit PipelinedTraceReader(const std::string& trace_fp) :
+                                  reader_(trace_fp), ring_(kRingCapacity, kBatchSize) {
+        producer_ = std::thread(&PipelinedTraceReader::produce, this);
+    }
+    ~PipelinedTraceReader() {
+        ring_.close();
+        producer_.join();
+    }
+    PipelinedTraceReader(const PipelinedTraceReader&) = delete;
+    PipelinedTraceReader& operator=(const PipelinedTraceReader&) = delete;
+
+    /**
+     * Reads the next record into the given record. Returns false at
+     * the end of trace; rethrows any error raised by the producer.
+     */
+    bool next(PipelinedRecord& record) {
+        if (ring_.pop(record)) { return true; }
+
+        // The ring is closed, so the producer is done with error_
+        if (error_) { std::rethrow_exception(error_); }
+        return false;
+    }
+};
+
+} // namespace utils
+
+#endif // pipelined_trace_reader_hpp
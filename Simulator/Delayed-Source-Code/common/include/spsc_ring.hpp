@@ -0,0 +1,115 @@
+#ifndef spsc_ring_hpp
+#define spsc_ring_hpp
+
+// STD headers
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/**
+ * Implements a bounded, lock-free single-producer/single-consumer ring.
+ *
+ * Items are exchanged in batches: the producer publishes its position
+ * (and the consumer releases consumed slots) once every batch_size
+ * items, so that the shared indices (each on its own cache line) are
+ * only touched once per batch. Either side publishes whatever it holds
+ * before it waits on the other, so the ring never deadlocks. Waiting
+ * is done by yielding, rather than by blocking on a condition.
+ */
+template<class T>
+class SPSCRing {
+private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    std::vector<T> slots_; // Ring slots
+    const size_t kMask; // Capacity - 1 (the capacity is a power of 2)
+    const size_t kBatchSize; // Items per batch
+
+    // Shared state
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0}; // Items released by the consumer
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0}; // Items published by the producer
+    alignas(kCacheLineSize) std::atomic<bool> is_closed_{false}; // Whether either side has closed
+
+    // Producer state
+    alignas(kCacheLineSize) size_t write_idx_ = 0; // Items written
+    size_t producer_head_ = 0; // Last observed value of head_
+
+    // Consumer state
+    alignas(kCacheLineSize) size_t read_idx_ = 0; // Items read
+    size_t consumer_tail_ = 0; // Last observed value of tail_
+
+public:
+    SPSCRing(const size_t capacity, const size_t batch_size) :
+             slots_(capacity), kMask(capacity - 1), kBatchSize(batch_size) {
+        assert(capacity > batch_size && (capacity & kMask) == 0);
+    }
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    /**
+     * Producer-side. Appends the given item, waiting for a free slot
+     * if the ring is full. Returns false if the consumer has closed
+     * the ring (which is checked once per batch, and while waiting).
+     */
+    bool push(const T& item) {
+        if (write_idx_ - producer_head_ > kMask) {
+            flush();
+            while (write_idx_ - (producer_head_ = head_.load(
+                   std::memory_order_acquire)) > kMask) {
+                if (is_closed_.load(std::memory_order_acquire)) { return false; }
+                std::this_thread::yield();
+            }
+        }
+        slots_[write_idx_ & kMask] = item;
+        if (++write_idx_ % kBatchSize == 0) {
+            flush();
+            return !is_closed_.load(std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    /**
+     * Producer-side. Publishes every item written so far.
+     */
+    void flush() { tail_.store(write_idx_, std::memory_order_release); }
+
+    /**
+     * Consumer-side. Pops the next item, waiting for one to be published
+     * if the ring is empty. Returns false once the ring is closed and
+     * every published item has been consumed.
+     */
+    bool pop(T& item) {
+        if (read_idx_ == consumer_tail_) {
+            head_.store(read_idx_, std::memory_order_release);
+            while ((consumer_tail_ = tail_.load(std::memory_order_acquire)) == read_idx_) {
+                if (is_closed_.load(std::memory_order_acquire)) {
+                    // The producer flushes before closing; check once more
+                    consumer_tail_ = tail_.load(std::memory_order_acquire);
+                    if (consumer_tail_ == read_idx_) { return false; }
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        item = slots_[read_idx_ & kMask];
+        if (++read_idx_ % kBatchSize == 0) {
+            head_.store(read_idx_, std::memory_order_release);
+        }
+        return true;
+    }
+
+    /**
+     * Closes the ring. The producer calls this at the end of its input
+     * (after a final flush()); the consumer may call it to stop the
+     * producer early.
+     */
+    void close() { is_closed_.store(true, std::memory_order_release); }
+};
+
+} // namespace utils
+
+#endif // spsc_ring_hpp
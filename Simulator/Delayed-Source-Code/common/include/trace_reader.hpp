@@ -0,0 +1,256 @@
+#ifndef trace_reader_hpp
+#define trace_reader_hpp
+
+// STD headers
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// POSIX headers
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils {
+
+/**
+ * A single trace record. The flow ID is a view into the mapped file
+ * and is only valid while the TraceReader is alive.
+ */
+struct TraceRecord {
+    uint64_t timestamp = 0;
+    std::string_view flow_id; // Empty for idle cycles (blank lines)
+    uint64_t flow_size = 1;
+};
+
+/**
+ * Binary trace format.
+ *
+ * A BinaryTraceHeader is followed by num_records fixed-width records
+ * (one per cycle, in trace order), and then by a table of num_objects
+ * names. The name of object i is stored as a uint32 length followed by
+ * its bytes. Object IDs are dense, assigned in order of first request.
+ * Idle cycles (blank lines in the text format) use kIdleObjectId.
+ */
+static constexpr char kBinaryTraceMagic[8] = {'D', 'H', 'T', 'R', 'A', 'C', 'E', 'B'};
+static constexpr uint32_t kBinaryTraceVersion = 1;
+static constexpr uint32_t kIdleObjectId = UINT32_MAX;
+
+struct BinaryTraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t num_objects;
+    uint64_t num_records;
+    uint64_t names_offset; // Offset (in bytes) of the names table
+};
+
+struct BinaryTraceRecord {
+    uint64_t timestamp;
+    uint64_t flow_size;
+    uint32_t object_id;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(BinaryTraceHeader) == 40, "Unexpected header layout");
+static_assert(sizeof(BinaryTraceRecord) == 24, "Unexpected record layout");
+
+/**
+ * Implements a zero-copy trace reader.
+ *
+ * The file is memory-mapped and read in place. Both trace formats are
+ * supported, and the format is detected from the file header:
+ *
+ * - Text "time;id;size" traces: each call to next() finds the next
+ *   newline and field separators with memchr, and parses the numeric
+ *   fields directly from the mapped bytes.
+ * - Binary traces (see BinaryTraceHeader): each call to next() decodes
+ *   one fixed-width record, and the flow ID is a view into the mapped
+ *   names table.
+ */
+class TraceReader {
+private:
+    int fd_ = -1; // File descriptor of the trace
+    const char* data_ = nullptr; // Start of the mapped trace
+    size_t size_ = 0; // Size of the trace (in bytes)
+    size_t begin_ = 0; // Offset of the first line/record
+    size_t end_ = 0; // Offset past the last line/record
+    size_t offset_ = 0; // Offset of the next unread line/record
+
+    bool is_binary_ = false; // Whether this is a binary trace
+    uint64_t num_records_ = 0; // Record count (binary traces only)
+    std::vector<std::string_view> names_; // Object names (binary traces only)
+
+    /**
+     * Internal helper method. If the mapped file is a binary trace,
+     * validates its header and indexes the names table.
+     */
+    void parseBinaryHeader(const std::string& trace_fp) {
+        BinaryTraceHeader header;
+        if (size_ < sizeof(header) || memcmp(data_, kBinaryTraceMagic,
+                                             sizeof(kBinaryTraceMagic)) != 0) {
+            return;
+        }
+        memcpy(&header, data_, sizeof(header));
+
+        const uint64_t records_end = sizeof(header) +
+            (header.num_records * sizeof(BinaryTraceRecord));
+        if (header.version != kBinaryTraceVersion ||
+            header.record_size != sizeof(BinaryTraceRecord) ||
+            header.names_offset != records_end || records_end > size_) {
+            throw std::runtime_error("Malformed binary trace: " + trace_fp);
+        }
+        // Index the names table
+        size_t offset = header.names_offset;
+        names_.reserve(header.num_objects);
+        for (uint64_t idx = 0; idx < header.num_objects; idx++) {
+            uint32_t length;
+            if (offset + sizeof(length) > size_) { throw std::runtime_error(
+                "Malformed binary trace: " + trace_fp);
+            }
+            memcpy(&length, data_ + offset, sizeof(length));
+            offset += sizeof(length);
+            if (offset + length > size_) { throw std::runtime_error(
+                "Malformed binary trace: " + trace_fp);
+            }
+            names_.emplace_back(data_ + offset, length);
+            offset += length;
+        }
+        is_binary_ = true;
+        num_records_ = header.num_records;
+        begin_ = sizeof(header);
+        end_ = records_end;
+    }
+
+    /**
+     * Internal helper method. Reads the next binary record.
+     */
+    bool nextBinary(TraceRecord& record) {
+        if (offset_ >= end_) { return false; }
+
+        BinaryTraceRecord raw;
+        memcpy(&raw, data_ + offset_, sizeof(raw));
+        offset_ += sizeof(raw);
+
+        record = TraceRecord();
+        record.timestamp = raw.timestamp;
+        if (raw.object_id != kIdleObjectId) {
+            if (raw.object_id >= names_.size()) { throw std::runtime_error(
+                "Malformed binary trace: object ID out of range");
+            }
+            record.flow_id = names_[raw.object_id];
+            record.flow_size = raw.flow_size;
+        }
+        return true;
+    }
+
+    /**
+     * Internal helper method. Parses an unsigned integer from the given
+     * field, skipping leading whitespace and stopping at the first non-
+     * digit. Returns the default value if the field has no digits.
+     */
+    static uint64_t parseUInt(const char* begin, const char* end,
+                              const uint64_t default_value) {
+        while (begin < end && (*begin == ' ' || *begin == '\t')) { begin++; }
+        if (begin == end || *begin < '0' || *begin > '9') {
+            return default_value;
+        }
+        uint64_t value = 0;
+        for (; begin < end && *begin >= '0' && *begin <= '9'; begin++) {
+            value = (value * 10) + static_cast<uint64_t>(*begin - '0');
+        }
+        return value;
+    }
+
+public:
+    explicit TraceReader(const std::string& trace_fp) {
+        fd_ = open(trace_fp.c_str(), O_RDONLY);
+        if (fd_ < 0) { throw std::runtime_error(
+            "Could not open trace file: " + trace_fp);
+        }
+        struct stat info;
+        if (fstat(fd_, &info) != 0) {
+            close(fd_);
+            throw std::runtime_error("Could not stat trace file: " + trace_fp);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+
+        // mmap() rejects zero-length mappings; an empty trace has no records
+        if (size_ > 0) {
+            void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (addr == MAP_FAILED) {
+                close(fd_);
+                throw std::runtime_error("Could not map trace file: " + trace_fp);
+            }
+            madvise(addr, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(addr);
+        }
+        end_ = size_;
+        try { parseBinaryHeader(trace_fp); }
+        catch (...) {
+            if (data_ != nullptr) { munmap(const_cast<char*>(data_), size_); }
+            close(fd_);
+            throw;
+        }
+        offset_ = begin_;
+    }
+    ~TraceReader() {
+        if (data_ != nullptr) { munmap(const_cast<char*>(data_), size_); }
+        if (fd_ >= 0) { close(fd_); }
+    }
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    // Accessors
+    bool isBinary() const { return is_binary_; }
+    uint64_t getNumObjects() const { return names_.size(); }
+    uint64_t getNumRecords() const { return num_records_; }
+
+    /**
+     * Reads the next line (or record) into the given record. Idle
+     * cycles yield a record with an empty flow ID. Returns false at
+     * the end of trace.
+     */
+    bool next(TraceRecord& record) {
+        if (is_binary_) { return nextBinary(record); }
+        if (offset_ >= end_) { return false; }
+
+        const char* line = data_ + offset_;
+        const char* eol = static_cast<const char*>(
+            memchr(line, '\n', size_ - offset_));
+        if (eol == nullptr) { eol = data_ + size_; }
+        offset_ = (eol - data_) + 1;
+
+        record = TraceRecord();
+        if (line == eol) { return true; }
+
+        // Timestamp
+        const char* sep = static_cast<const char*>(memchr(line, ';', eol - line));
+        const char* ts_end = (sep != nullptr) ? sep : eol;
+        record.timestamp = parseUInt(line, ts_end, 0);
+        if (sep == nullptr) { return true; }
+
+        // Flow ID
+        const char* id = sep + 1;
+        sep = static_cast<const char*>(memchr(id, ';', eol - id));
+        const char* id_end = (sep != nullptr) ? sep : eol;
+        record.flow_id = std::string_view(id, id_end - id);
+
+        // Flow size
+        if (sep != nullptr) { record.flow_size = parseUInt(sep + 1, eol, 1); }
+        return true;
+    }
+
+    /**
+     * Restarts reading from the beginning of the trace.
+     */
+    void rewind() { offset_ = begin_; }
+};
+
+} // namespace utils
+
+#endif // trace_reader_hpp
@@ -5,15 +5,22 @@
 #include <algorithm>
 #include <array>
 #include <assert.h>
+#include <deque>
 #include <fstream>
+#include <list>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 // Boost headers
 #include <boost/functional/hash.hpp>
 
+// Custom headers
+#include "flat_hash_map.hpp"
+#include "trace_reader.hpp"
+
 // Macros
 #define SUPPRESS_UNUSED_WARNING(a) ((void) a)
 
@@ -30,13 +37,53 @@ bool DoubleApproxGreaterThanOrEqual(const double a, const double b,
     return (a > b) || DoubleApproxEqual(a, b, epsilon);
 }
 
+/**
+ * Dense flow/object handle. Handles are assigned by a FlowIdTable in
+ * order of first appearance, starting at 0.
+ */
+typedef uint32_t FlowId;
+static constexpr FlowId kInvalidFlowId = UINT32_MAX;
+
+/**
+ * Interns flow IDs into dense FlowId handles.
+ */
+class FlowIdTable {
+private:
+    std::deque<std::string> names_; // Flow names, indexed by handle. A deque
+                                    // keeps the strings (and the views into
+                                    // them) stable as the table grows.
+    FlatHashMap<std::string_view, FlowId> ids_; // Dict mapping names to handles
+
+public:
+    // Accessors
+    size_t size() const { return names_.size(); }
+    const std::string& name(const FlowId id) const { return names_[id]; }
+
+    /**
+     * Returns the handle for the given name, assigning
+     * the next free handle if the name is new.
+     */
+    FlowId intern(std::string_view name) {
+        auto iter = ids_.find(name);
+        if (iter != ids_.end()) { return iter->second; }
+
+        if (names_.size() >= kInvalidFlowId) { throw std::runtime_error(
+            "Too many flows for 32-bit flow IDs.");
+        }
+        const FlowId id = static_cast<FlowId>(names_.size());
+        names_.emplace_back(name);
+        ids_.emplace(names_.back(), id);
+        return id;
+    }
+};
+
 /**
  * Represents a network packet.
  */
 class Packet {
 private:
     // Flow/Object identifier
-    const std::string flow_id_;
+    FlowId flow_id_;
     uint64_t flow_size_;
 
     // Housekeeping
@@ -46,7 +93,7 @@ private:
     bool is_finalized_ = false;
 
 public:
-    Packet(const std::string& flow_id, uint64_t flow_size) : flow_id_(flow_id),flow_size_(flow_size) {}
+    Packet(const FlowId flow_id, uint64_t flow_size) : flow_id_(flow_id),flow_size_(flow_size) {}
 
     // Error-handling
     inline bool checkNotFinalized() {
@@ -58,7 +105,7 @@ public:
 
     // Accessors
     bool isFinalized() const { return is_finalized_; }
-    const std::string& getFlowId() const { return flow_id_; }
+    FlowId getFlowId() const { return flow_id_; }
     uint64_t getFlowSize() {return flow_size_;};
     double getTotalLatency() const { return total_latency_; }
     double getQueueingDelay() const { return queueing_delay_; }
@@ -108,23 +155,13 @@ public:
  */
 std::vector<std::string>
 parseTrace(const std::string& trace_fp) {
-    std::ifstream trace_ifs(trace_fp);
+    TraceReader reader(trace_fp);
+    TraceRecord record;
     std::vector<std::string> trace;
-    std::string line;
 
     // Populate the trace vector
-    while (std::getline(trace_ifs, line)) {
-        std::string timestamp, flow_id;
-
-        // Nonempty packet
-        if (!line.empty()) {
-            std::stringstream linestream(line);
-
-            // Parse the packet's timestamp and flow ID
-            std::getline(linestream, timestamp, ';');
-            std::getline(linestream, flow_id, ';');
-        }
-        trace.push_back(flow_id);
+    while (reader.next(record)) {
+        trace.emplace_back(record.flow_id);
     }
     return trace;
 }
@@ -136,31 +173,27 @@ class TraceAnalyzer {
 private:
     const std::string trace_fp_; // Path to trace file
     size_t num_total_packets_ = 0; // Total packet count
-    std::unordered_map<std::string, FlowData> flow_ids_to_data_map_;
+    std::vector<FlowData> flow_data_; // Flow data, indexed by FlowId
 
     /**
      * Internal helper method. Generates a mapping between flow
      * IDs and the relevant flow metadata for the given trace.
      */
-    void analyzeFlowArrivals() {
-        std::ifstream trace_ifs(trace_fp_);
+    void analyzeFlowArrivals(FlowIdTable& flow_ids) {
+        TraceReader reader(trace_fp_);
+        TraceRecord record;
 
-        // Populate the trace vector
-        std::string line;
-        while (std::getline(trace_ifs, line)) {
+        // Populate the flow data
+        while (reader.next(record)) {
 
             // Non-empty packet
-            if (!line.empty()) {
-                std::string timestamp, flow_id;
-                std::stringstream linestream(line);
-
-                // Parse the packet's timestamp and flow ID
-                std::getline(linestream, timestamp, ';');
-                std::getline(linestream, flow_id, ';');
-
+            if (!record.flow_id.empty()) {
                 // Update the corresponding flow data
-                FlowData& flow_data = flow_ids_to_data_map_[flow_id];
-                flow_data.addPacket(num_total_packets_);
+                const FlowId flow_id = flow_ids.intern(record.flow_id);
+                if (flow_id >= flow_data_.size()) {
+                    flow_data_.resize(flow_id + 1);
+                }
+                flow_data_[flow_id].addPacket(num_total_packets_);
             }
             // Update the total packet count
             num_total_packets_++;
@@ -168,17 +201,16 @@ private:
     }
 
 public:
-    TraceAnalyzer(const std::string& trace_fp) :
-    trace_fp_(trace_fp) { analyzeFlowArrivals(); }
+    TraceAnalyzer(const std::string& trace_fp, FlowIdTable& flow_ids) :
+    trace_fp_(trace_fp) { analyzeFlowArrivals(flow_ids); }
 
     // Accessors
     size_t getNumPackets() const { return num_total_packets_; }
-    size_t getNumFlows() const { return flow_ids_to_data_map_.size(); }
-    const FlowData& getFlowData(const std::string& flow_id) const {
-        return flow_ids_to_data_map_.at(flow_id);
+    size_t getNumFlows() const { return flow_data_.size(); }
+    const FlowData& getFlowData(const FlowId flow_id) const {
+        return flow_data_.at(flow_id);
     }
-    const std::unordered_map<std::string, FlowData>&
-    getFlowIdsToDataMap() const { return flow_ids_to_data_map_; }
+    const std::vector<FlowData>& getAllFlowData() const { return flow_data_; }
 };
 
 /**
@@ -273,23 +305,17 @@ TraceMetadata getFlowCounts(const std::string& trace_fp) {
     typedef std::pair<size_t, size_t> IdxRange; // [start, end]
 
     std::unordered_map<std::string, IdxRange> idx_ranges;
-    std::ifstream trace_ifs(trace_fp);
-    std::string line;
+    TraceReader reader(trace_fp);
+    TraceRecord record;
     size_t idx = 0;
 
-    // Populate the trace vector
-    while (std::getline(trace_ifs, line)) {
+    // Populate the idx ranges
+    while (reader.next(record)) {
 
         // Nonempty packet
-        if (!line.empty()) {
-            std::string timestamp, flow_id;
-            std::stringstream linestream(line);
-
-            // Parse the packet's timestamp and flow ID
-            std::getline(linestream, timestamp, ';');
-            std::getline(linestream, flow_id, ';');
-
+        if (!record.flow_id.empty()) {
             // This is the first request to this flow
+            const std::string flow_id(record.flow_id);
             auto iter = idx_ranges.find(flow_id);
             if (iter == idx_ranges.end()) {
                 idx_ranges[flow_id] = std::make_pair(idx, idx);
@@ -0,0 +1,127 @@
+// STD headers
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Boost headers
+#include <boost/program_options.hpp>
+
+// Custom headers
+#include "trace_reader.hpp"
+
+/**
+ * Converts a "time;id;size" text trace into the binary trace format
+ * (see utils::BinaryTraceHeader). Object IDs are assigned densely, in
+ * order of first request, and the original names are kept in the
+ * names table so that simulation results are unchanged.
+ */
+int main(int argc, char** argv) {
+    using namespace boost::program_options;
+
+    std::string trace_fp;
+    std::string output_fp;
+
+    // Program options
+    variables_map variables;
+    options_description desc{"Converts a text trace to the binary trace format"};
+
+    try {
+        // Command-line arguments
+        desc.add_options()
+            ("help",        "Prints this message")
+            ("trace",       value<std::string>(&trace_fp)->required(),     "Input trace file path")
+            ("output",      value<std::string>(&output_fp)->required(),    "Output binary trace file path");
+
+        // Parse model parameters
+        store(parse_command_line(argc, argv, desc), variables);
+
+        // Handle help flag
+        if (variables.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        notify(variables);
+    }
+    // Flag argument errors
+    catch(const required_option& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...) {
+        std::cerr << "Unknown Error." << std::endl;
+        return 1;
+    }
+
+    utils::TraceReader reader(trace_fp);
+    utils::TraceRecord record;
+
+    // Names are views into the mapped input, which outlives this loop
+    std::unordered_map<std::string_view, uint32_t> object_ids;
+    std::vector<std::string_view> names;
+
+    std::ofstream file(output_fp, std::ios::out | std::ios::binary |
+                                  std::ios::trunc);
+    if (!file) {
+        std::cerr << "Error: Could not open " << output_fp << std::endl;
+        return 1;
+    }
+    // Reserve space for the header; it is rewritten once the counts are known
+    utils::BinaryTraceHeader header{};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Write the records
+    uint64_t num_records = 0;
+    while (reader.next(record)) {
+        utils::BinaryTraceRecord raw{};
+        raw.timestamp = record.timestamp;
+        raw.object_id = utils::kIdleObjectId;
+
+        if (!record.flow_id.empty()) {
+            auto iter = object_ids.find(record.flow_id);
+            if (iter == object_ids.end()) {
+                if (names.size() >= utils::kIdleObjectId) {
+                    std::cerr << "Error: Too many objects for 32-bit IDs" << std::endl;
+                    return 1;
+                }
+                iter = object_ids.emplace(record.flow_id, names.size()).first;
+                names.push_back(record.flow_id);
+            }
+            raw.object_id = iter->second;
+            raw.flow_size = record.flow_size;
+        }
+        file.write(reinterpret_cast<const char*>(&raw), sizeof(raw));
+        num_records++;
+    }
+
+    // Write the names table
+    for (const std::string_view& name : names) {
+        const uint32_t length = static_cast<uint32_t>(name.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(name.data(), name.size());
+    }
+
+    // Finally, write the header
+    std::copy(std::begin(utils::kBinaryTraceMagic),
+              std::end(utils::kBinaryTraceMagic), header.magic);
+    header.version = utils::kBinaryTraceVersion;
+    header.record_size = sizeof(utils::BinaryTraceRecord);
+    header.num_objects = names.size();
+    header.num_records = num_records;
+    header.names_offset = sizeof(header) + (num_records *
+                                            sizeof(utils::BinaryTraceRecord));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+
+    if (!file) {
+        std::cerr << "Error: Could not write " << output_fp << std::endl;
+        return 1;
+    }
+    std::cout << "Objects: " << header.num_objects << std::endl;
+    std::cout << "Records: " << header.num_records << std::endl;
+    return 0;
+}
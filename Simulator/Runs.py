@@ -12,6 +12,8 @@ class Run:
 
         self.Latency =  [1,10,100,1000,2000,5000,10000,20000,50000,100000]
 
+        self.RawLats = " --rawlats"  # Per-request latencies, used by "ComLats.py"
+
         self.CmdRoot = Cmdroot
         self.TracePath = None
         self.OutPath = None
@@ -26,10 +28,11 @@ class Run:
         Name = Name.split(".")[0]
         Algos = self.Algos[Name]
 
-        for l in self.Latency:
-            for a in Algos:
-                Cmd = self.CmdRoot + "/cache_" + a + " --trace " + self.TracePath + " --csize " + str(self.CSize) + " --latency " + str(l) + " --outpath " + self.OutPath
-                CMDs.append(Cmd)
+        # Each simulator runs every latency over a single parse of the trace
+        Latencies = " ".join(str(l) for l in self.Latency)
+        for a in Algos:
+            Cmd = self.CmdRoot + "/cache_" + a + " --trace " + self.TracePath + " --csize " + str(self.CSize) + " --latency " + Latencies + " --outpath " + self.OutPath + self.RawLats
+            CMDs.append(Cmd)
 
         return CMDs
 
@@ -39,10 +42,11 @@ class Run:
         As = ["la","lru_aggdelay","lhd_aggdelay","lru"]
         CMDs = []
 
-        for c in CSizes:
-            for a in As:
-                Cmd = self.CmdRoot + "/cache_" + a + " --trace " + self.TracePath + " --csize " + str(c) + " --latency " + str(FixL) + " --outpath " + self.OutPath
-                CMDs.append(Cmd)
+        # Each simulator runs every cache size over a single parse of the trace
+        Sizes = " ".join(str(c) for c in CSizes)
+        for a in As:
+            Cmd = self.CmdRoot + "/cache_" + a + " --trace " + self.TracePath + " --csize " + Sizes + " --latency " + str(FixL) + " --outpath " + self.OutPath + self.RawLats
+            CMDs.append(Cmd)
 
         return CMDs
 